@@ -0,0 +1,250 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "aead.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Aead::Aead()
+    {
+        _poly.setMacOnly(true);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Aead::~Aead()
+    {
+        clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Aead::available(Kind kind)
+    {
+        switch(kind)
+        {
+        case Kind::chacha20poly1305:
+            return true;
+
+        case Kind::aes256gcm:
+            return AesGcm::available();
+
+        case Kind::chacha20poly1305ietf:
+        case Kind::poly1305:
+            return ChaChaPoly::available();
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint8 Aead::availableMask()
+    {
+        uint8 res = 0;
+        for(uint8 k(0); k<_kindsAmount; ++k)
+        {
+            if(available(static_cast<Kind>(k)))
+            {
+                res |= uint8(1) << k;
+            }
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::setKind(Kind kind)
+    {
+        dbgAssert(available(kind));
+
+        if(_kind != kind)
+        {
+            clear();
+            _kind = kind;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Aead::Kind Aead::kind() const
+    {
+        return _kind;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const ChaChaPoly* Aead::chachaPoly() const
+    {
+        return Kind::chacha20poly1305ietf == _kind ? &_chachaPoly : nullptr;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::setKey(const void* key, uint32 keySize)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.setKey(key, keySize);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.setKey(key, keySize);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.setKey(key, keySize);
+            break;
+
+        case Kind::poly1305:
+            _poly.setKey(key, keySize);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::setAd(const void* ad, uint32 adSize)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.setAd(ad, adSize);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.setAd(ad, adSize);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.setAd(ad, adSize);
+            break;
+
+        case Kind::poly1305:
+            _poly.setAd(ad, adSize);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::start(const void* nonce, uint32 nonceSize)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.start(nonce, nonceSize);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.start(nonce, nonceSize);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.start(nonce, nonceSize);
+            break;
+
+        case Kind::poly1305:
+            _poly.start(nonce, nonceSize);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::encipher(const void* src, void* dst, uint32 size)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.encipher(src, dst, size);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.encipher(src, dst, size);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.encipher(src, dst, size);
+            break;
+
+        case Kind::poly1305:
+            _poly.encipher(src, dst, size);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::decipher(const void* src, void* dst, uint32 size)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.decipher(src, dst, size);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.decipher(src, dst, size);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.decipher(src, dst, size);
+            break;
+
+        case Kind::poly1305:
+            _poly.decipher(src, dst, size);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::encipherFinish(void* macOut)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            _chacha.encipherFinish(macOut);
+            break;
+
+        case Kind::aes256gcm:
+            _aesGcm.encipherFinish(macOut);
+            break;
+
+        case Kind::chacha20poly1305ietf:
+            _chachaPoly.encipherFinish(macOut);
+            break;
+
+        case Kind::poly1305:
+            _poly.encipherFinish(macOut);
+            break;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Aead::decipherFinish(const void* macIn)
+    {
+        switch(_kind)
+        {
+        case Kind::chacha20poly1305:
+            return _chacha.decipherFinish(macIn);
+
+        case Kind::aes256gcm:
+            return _aesGcm.decipherFinish(macIn);
+
+        case Kind::chacha20poly1305ietf:
+            return _chachaPoly.decipherFinish(macIn);
+
+        case Kind::poly1305:
+            return _poly.decipherFinish(macIn);
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Aead::clear()
+    {
+        _chacha.clear();
+        _aesGcm.clear();
+        _chachaPoly.clear();
+        _poly.clear();
+    }
+}
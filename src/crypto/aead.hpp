@@ -0,0 +1,64 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "pch.hpp"
+#include "aesGcm.hpp"
+#include "chachaPoly.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    //AEAD с выбором алгоритма, интерфейс как у dci::crypto::ChaCha20Poly1305
+    class Aead
+    {
+    public:
+        //значения идут в протокол, битовая маска 1<<kind совпадает с apip::Aead
+        enum class Kind : uint8
+        {
+            chacha20poly1305        = 0,
+            aes256gcm               = 1,
+            chacha20poly1305ietf    = 2,
+            poly1305                = 3,//только аутентификация, данные идут открыто
+        };
+
+        static constexpr uint8 _kindsAmount = 4;
+
+    public:
+        Aead();
+        ~Aead();
+
+        static bool available(Kind kind);
+        static uint8 availableMask();
+
+        void setKind(Kind kind);
+        Kind kind() const;
+
+        //ядро chacha20poly1305ietf для пакетной обработки, nullptr при другом алгоритме
+        const ChaChaPoly* chachaPoly() const;
+
+        void setKey(const void* key, uint32 keySize);
+        void setAd(const void* ad, uint32 adSize);
+        void start(const void* nonce, uint32 nonceSize);
+
+        void encipher(const void* src, void* dst, uint32 size);
+        void decipher(const void* src, void* dst, uint32 size);
+
+        void encipherFinish(void* macOut);
+        bool decipherFinish(const void* macIn);
+
+        void clear();
+
+    private:
+        Kind                            _kind = Kind::chacha20poly1305;
+        dci::crypto::ChaCha20Poly1305   _chacha;
+        AesGcm                          _aesGcm;
+        ChaChaPoly                      _chachaPoly;
+        ChaChaPoly                      _poly;
+    };
+}
@@ -0,0 +1,476 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "aesGcm.hpp"
+#include "secret.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#   include <immintrin.h>
+#   define AESGCM_NI 1
+#   define AESGCM_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+#else
+#   define AESGCM_NI 0
+#   define AESGCM_TARGET
+#endif
+
+namespace dci::module::stiac::crypto
+{
+#if AESGCM_NI
+    namespace
+    {
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i bswap(__m128i v)
+        {
+            return _mm_shuffle_epi8(v, _mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i load(const void* p)
+        {
+            return _mm_loadu_si128(static_cast<const __m128i*>(p));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline void store(void* p, __m128i v)
+        {
+            _mm_storeu_si128(static_cast<__m128i*>(p), v);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        template <int rcon>
+        AESGCM_TARGET inline void expandKeyStep(__m128i& k1, __m128i& k2, __m128i* out)
+        {
+            __m128i t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k2, rcon), 0xff);
+            k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+            k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+            k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+            k1 = _mm_xor_si128(k1, t);
+            out[0] = k1;
+
+            if constexpr(rcon != 0x40)
+            {
+                t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k1, 0), 0xaa);
+                k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+                k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+                k2 = _mm_xor_si128(k2, _mm_slli_si128(k2, 4));
+                k2 = _mm_xor_si128(k2, t);
+                out[1] = k2;
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET void expandKey(const uint8* key, __m128i* rk)
+        {
+            __m128i k1 = load(key);
+            __m128i k2 = load(key + 16);
+            rk[0] = k1;
+            rk[1] = k2;
+
+            expandKeyStep<0x01>(k1, k2, rk + 2);
+            expandKeyStep<0x02>(k1, k2, rk + 4);
+            expandKeyStep<0x04>(k1, k2, rk + 6);
+            expandKeyStep<0x08>(k1, k2, rk + 8);
+            expandKeyStep<0x10>(k1, k2, rk + 10);
+            expandKeyStep<0x20>(k1, k2, rk + 12);
+            expandKeyStep<0x40>(k1, k2, rk + 14);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i encryptBlock(const __m128i* rk, __m128i b)
+        {
+            b = _mm_xor_si128(b, rk[0]);
+            for(int i(1); i<14; ++i)
+            {
+                b = _mm_aesenc_si128(b, rk[i]);
+            }
+            return _mm_aesenclast_si128(b, rk[14]);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //восемь блоков параллельно - конвейер aesenc
+        AESGCM_TARGET inline void encryptBlocks8(const __m128i* rk, __m128i* b)
+        {
+            for(int j(0); j<8; ++j) b[j] = _mm_xor_si128(b[j], rk[0]);
+
+            for(int i(1); i<14; ++i)
+            {
+                const __m128i k = rk[i];
+                for(int j(0); j<8; ++j) b[j] = _mm_aesenc_si128(b[j], k);
+            }
+
+            for(int j(0); j<8; ++j) b[j] = _mm_aesenclast_si128(b[j], rk[14]);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //произведение без редукции, 256 бит в lo:hi
+        AESGCM_TARGET inline void clmul(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+        {
+            __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+            __m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+            __m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+
+            lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+            hi = _mm_xor_si128(t2, _mm_srli_si128(t1, 8));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //сдвиг на бит (отраженное представление) и редукция по x^128 + x^7 + x^2 + x + 1
+        AESGCM_TARGET inline __m128i reduce(__m128i lo, __m128i hi)
+        {
+            __m128i c1 = _mm_srli_epi32(lo, 31);
+            __m128i c2 = _mm_srli_epi32(hi, 31);
+            lo = _mm_slli_epi32(lo, 1);
+            hi = _mm_slli_epi32(hi, 1);
+
+            __m128i c3 = _mm_srli_si128(c1, 12);
+            c2 = _mm_slli_si128(c2, 4);
+            c1 = _mm_slli_si128(c1, 4);
+            lo = _mm_or_si128(lo, c1);
+            hi = _mm_or_si128(hi, c2);
+            hi = _mm_or_si128(hi, c3);
+
+            __m128i a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+            __m128i b = _mm_srli_si128(a, 4);
+            a = _mm_slli_si128(a, 12);
+            lo = _mm_xor_si128(lo, a);
+
+            __m128i d = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+            d = _mm_xor_si128(d, b);
+            lo = _mm_xor_si128(lo, d);
+
+            return _mm_xor_si128(hi, lo);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i gfmul(__m128i a, __m128i b)
+        {
+            __m128i lo, hi;
+            clmul(a, b, lo, hi);
+            return reduce(lo, hi);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i ghash1(__m128i x, const __m128i* h, __m128i block)
+        {
+            return gfmul(_mm_xor_si128(x, bswap(block)), h[0]);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //четыре блока с одной редукцией: (((x^b0)H^4) ^ b1 H^3 ^ b2 H^2 ^ b3 H
+        AESGCM_TARGET inline __m128i ghash4(__m128i x, const __m128i* h, const __m128i* blocks)
+        {
+            __m128i lo, hi, l, r;
+
+            clmul(_mm_xor_si128(x, bswap(blocks[0])), h[3], lo, hi);
+
+            clmul(bswap(blocks[1]), h[2], l, r);
+            lo = _mm_xor_si128(lo, l);
+            hi = _mm_xor_si128(hi, r);
+
+            clmul(bswap(blocks[2]), h[1], l, r);
+            lo = _mm_xor_si128(lo, l);
+            hi = _mm_xor_si128(hi, r);
+
+            clmul(bswap(blocks[3]), h[0], l, r);
+            lo = _mm_xor_si128(lo, l);
+            hi = _mm_xor_si128(hi, r);
+
+            return reduce(lo, hi);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        AESGCM_TARGET inline __m128i counterBlock(__m128i j0Swapped, uint32 counter)
+        {
+            return bswap(_mm_insert_epi32(j0Swapped, static_cast<int>(counter), 0));
+        }
+    }
+#endif
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AesGcm::AesGcm()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AesGcm::~AesGcm()
+    {
+        clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool AesGcm::available()
+    {
+#if AESGCM_NI
+        static const bool res =
+                __builtin_cpu_supports("aes") &&
+                __builtin_cpu_supports("pclmul") &&
+                __builtin_cpu_supports("ssse3") &&
+                __builtin_cpu_supports("sse4.1");
+        return res;
+#else
+        return false;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AESGCM_TARGET void AesGcm::setKey(const void* key, uint32 keySize)
+    {
+        dbgAssert(_keySize == keySize);
+        dbgAssert(available());
+        (void)keySize;
+
+#if AESGCM_NI
+        __m128i* rk = reinterpret_cast<__m128i*>(_roundKeys);
+        expandKey(static_cast<const uint8*>(key), rk);
+
+        __m128i* h = reinterpret_cast<__m128i*>(_h);
+        h[0] = bswap(encryptBlock(rk, _mm_setzero_si128()));
+        for(uint32 i(1); i<_hPowers; ++i)
+        {
+            h[i] = gfmul(h[i-1], h[0]);
+        }
+#else
+        (void)key;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void AesGcm::setAd(const void* ad, uint32 adSize)
+    {
+        dbgAssert(adSize <= _maxAdSize);
+        _adSize = std::min(adSize, _maxAdSize);
+        std::memcpy(_ad, ad, _adSize);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AESGCM_TARGET void AesGcm::start(const void* nonce, uint32 nonceSize)
+    {
+        dbgAssert(8 == nonceSize || 12 == nonceSize);
+
+        std::memset(_j0, 0, sizeof(_j0));
+        std::memcpy(_j0 + 12 - nonceSize, nonce, nonceSize);
+        _j0[15] = 1;
+
+        _counter = 2;
+        _textSize = 0;
+
+#if AESGCM_NI
+        const __m128i* h = reinterpret_cast<const __m128i*>(_h);
+        __m128i x = _mm_setzero_si128();
+
+        uint32 adOffset = 0;
+        for(; adOffset + _blockSize <= _adSize; adOffset += _blockSize)
+        {
+            x = ghash1(x, h, load(_ad + adOffset));
+        }
+
+        if(adOffset < _adSize)
+        {
+            alignas(16) uint8 tail[_blockSize] {};
+            std::memcpy(tail, _ad + adOffset, _adSize - adOffset);
+            x = ghash1(x, h, load(tail));
+        }
+
+        store(_ghash, x);
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void AesGcm::encipher(const void* src, void* dst, uint32 size)
+    {
+        process(static_cast<const uint8*>(src), static_cast<uint8*>(dst), size, true);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void AesGcm::decipher(const void* src, void* dst, uint32 size)
+    {
+        process(static_cast<const uint8*>(src), static_cast<uint8*>(dst), size, false);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void AesGcm::encipherFinish(void* macOut)
+    {
+        finish(static_cast<uint8*>(macOut));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool AesGcm::decipherFinish(const void* macIn)
+    {
+        uint8 tag[_macSize];
+        finish(tag);
+
+        const uint8* expected = static_cast<const uint8*>(macIn);
+        uint8 diff = 0;
+        for(uint32 i(0); i<_macSize; ++i)
+        {
+            diff |= tag[i] ^ expected[i];
+        }
+
+        cleanMemoryUnder(tag);
+        return 0 == diff;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void AesGcm::clear()
+    {
+        cleanMemoryUnder(_roundKeys);
+        cleanMemoryUnder(_h);
+        cleanMemoryUnder(_j0);
+        cleanMemoryUnder(_ghash);
+        cleanMemoryUnder(_keyStream);
+        cleanMemoryUnder(_partial);
+        cleanMemoryUnder(_ad);
+        _adSize = 0;
+        _counter = 0;
+        _textSize = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AESGCM_TARGET void AesGcm::process(const uint8* src, uint8* dst, uint32 size, bool encipher)
+    {
+#if AESGCM_NI
+        const __m128i* rk = reinterpret_cast<const __m128i*>(_roundKeys);
+        const __m128i* h = reinterpret_cast<const __m128i*>(_h);
+
+        uint32 pos = static_cast<uint32>(_textSize % _blockSize);
+        _textSize += size;
+
+        //дописать начатый блок
+        if(pos)
+        {
+            uint32 amount = std::min(_blockSize - pos, size);
+            for(uint32 i(0); i<amount; ++i)
+            {
+                uint8 in = src[i];
+                uint8 out = in ^ _keyStream[pos+i];
+                _partial[pos+i] = encipher ? out : in;
+                dst[i] = out;
+            }
+
+            pos += amount;
+            src += amount;
+            dst += amount;
+            size -= amount;
+
+            if(pos < _blockSize)
+            {
+                return;
+            }
+
+            store(_ghash, ghash1(load(_ghash), h, load(_partial)));
+        }
+
+        __m128i x = load(_ghash);
+        const __m128i j0Swapped = bswap(load(_j0));
+
+        //пачками по 8 блоков
+        while(size >= 8*_blockSize)
+        {
+            __m128i ks[8];
+            for(uint32 j(0); j<8; ++j)
+            {
+                ks[j] = counterBlock(j0Swapped, _counter++);
+            }
+            encryptBlocks8(rk, ks);
+
+            __m128i in[8];
+            for(uint32 j(0); j<8; ++j)
+            {
+                in[j] = load(src + j*_blockSize);
+            }
+
+            __m128i out[8];
+            for(uint32 j(0); j<8; ++j)
+            {
+                out[j] = _mm_xor_si128(in[j], ks[j]);
+                store(dst + j*_blockSize, out[j]);
+            }
+
+            const __m128i* cipherText = encipher ? out : in;
+            x = ghash4(x, h, cipherText);
+            x = ghash4(x, h, cipherText+4);
+
+            src += 8*_blockSize;
+            dst += 8*_blockSize;
+            size -= 8*_blockSize;
+        }
+
+        //поблочно
+        while(size >= _blockSize)
+        {
+            __m128i ks = encryptBlock(rk, counterBlock(j0Swapped, _counter++));
+            __m128i in = load(src);
+            __m128i out = _mm_xor_si128(in, ks);
+            store(dst, out);
+
+            x = ghash1(x, h, encipher ? out : in);
+
+            src += _blockSize;
+            dst += _blockSize;
+            size -= _blockSize;
+        }
+
+        store(_ghash, x);
+
+        //начать неполный блок, остаток гаммы сохранить для следующей порции
+        if(size)
+        {
+            store(_keyStream, encryptBlock(rk, counterBlock(j0Swapped, _counter++)));
+
+            for(uint32 i(0); i<size; ++i)
+            {
+                uint8 in = src[i];
+                uint8 out = in ^ _keyStream[i];
+                _partial[i] = encipher ? out : in;
+                dst[i] = out;
+            }
+        }
+#else
+        (void)src;
+        (void)dst;
+        (void)size;
+        (void)encipher;
+        dbgWarn("AES-GCM is not supported on this platform");
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    AESGCM_TARGET void AesGcm::finish(uint8 tag[_macSize])
+    {
+#if AESGCM_NI
+        const __m128i* rk = reinterpret_cast<const __m128i*>(_roundKeys);
+        const __m128i* h = reinterpret_cast<const __m128i*>(_h);
+
+        __m128i x = load(_ghash);
+
+        uint32 pos = static_cast<uint32>(_textSize % _blockSize);
+        if(pos)
+        {
+            std::memset(_partial + pos, 0, _blockSize - pos);
+            x = ghash1(x, h, load(_partial));
+        }
+
+        //длины в битах, big endian
+        __m128i lengths = _mm_set_epi64x(
+                    static_cast<long long>(uint64(_adSize) * 8),
+                    static_cast<long long>(_textSize * 8));
+        x = gfmul(_mm_xor_si128(x, lengths), h[0]);
+
+        store(tag, _mm_xor_si128(bswap(x), encryptBlock(rk, load(_j0))));
+
+        cleanMemoryUnder(_ghash);
+        cleanMemoryUnder(_keyStream);
+        cleanMemoryUnder(_partial);
+#else
+        std::memset(tag, 0, _macSize);
+        dbgWarn("AES-GCM is not supported on this platform");
+#endif
+    }
+}
+
+#undef AESGCM_TARGET
+#undef AESGCM_NI
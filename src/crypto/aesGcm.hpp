@@ -0,0 +1,73 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "pch.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /* AES-256-GCM на AES-NI + PCLMULQDQ.
+     *
+     * Интерфейс повторяет dci::crypto::ChaCha20Poly1305: потоковые encipher/decipher порциями
+     * произвольного размера между start и *Finish. Программной реализации нет, без поддержки
+     * процессором available() ложно и алгоритм не предлагается удаленной стороне.
+     *
+     * Нонс 8 байт дополняется слева четырьмя нулями до 12 байт IV.
+     */
+    class AesGcm
+    {
+    public:
+        static constexpr uint32 _keySize = 32;
+        static constexpr uint32 _macSize = 16;
+
+    public:
+        AesGcm();
+        ~AesGcm();
+
+        static bool available();
+
+        void setKey(const void* key, uint32 keySize);
+        void setAd(const void* ad, uint32 adSize);
+        void start(const void* nonce, uint32 nonceSize);
+
+        void encipher(const void* src, void* dst, uint32 size);
+        void decipher(const void* src, void* dst, uint32 size);
+
+        void encipherFinish(void* macOut);
+        bool decipherFinish(const void* macIn);
+
+        void clear();
+
+    private:
+        void process(const uint8* src, uint8* dst, uint32 size, bool encipher);
+        void finish(uint8 tag[_macSize]);
+
+    private:
+        static constexpr uint32 _blockSize = 16;
+        static constexpr uint32 _rounds = 14;
+        static constexpr uint32 _hPowers = 4;
+        static constexpr uint32 _maxAdSize = 64;
+
+        alignas(16) uint8   _roundKeys[(_rounds+1) * _blockSize] {};
+
+        //степени H в форме для ghash (байты развернуты)
+        alignas(16) uint8   _h[_hPowers * _blockSize] {};
+
+        //текущее сообщение
+        alignas(16) uint8   _j0[_blockSize] {};
+        alignas(16) uint8   _ghash[_blockSize] {};
+        alignas(16) uint8   _keyStream[_blockSize] {};
+        alignas(16) uint8   _partial[_blockSize] {};
+
+        uint8               _ad[_maxAdSize] {};
+        uint32              _adSize = 0;
+
+        uint32              _counter = 0;
+        uint64              _textSize = 0;
+    };
+}
@@ -0,0 +1,139 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "batchCipher.hpp"
+#include "secret.hpp"
+#include "stages/out/ciphering.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    BatchCipher::BatchCipher()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    BatchCipher::~BatchCipher()
+    {
+        _ticker.stop();
+
+        for(Job& job : _jobs)
+        {
+            cleanMemoryUnder(job._key);
+            cleanMemoryUnder(job._data.data(), static_cast<uint32>(job._data.size()));
+        }
+        _jobs.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::shared_ptr<BatchCipher> BatchCipher::attach()
+    {
+        static thread_local std::weak_ptr<BatchCipher> instance;
+
+        std::shared_ptr<BatchCipher> res = instance.lock();
+        if(!res)
+        {
+            res = std::make_shared<BatchCipher>();
+            instance = res;
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    BatchCipher::Job& BatchCipher::enqueue(stages::out::Ciphering* owner)
+    {
+        if(_jobs.empty())
+        {
+            _ticker.start();
+        }
+
+        _jobs.emplace_back();
+        _jobs.back()._owner = owner;
+        return _jobs.back();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void BatchCipher::flush()
+    {
+        _ticker.stop();
+
+        auto lifeLocker = shared_from_this();
+
+        cipher();
+
+        //выдача может привести к новым постановкам и вложенному flush, порядок держится очередью
+        while(!_jobs.empty())
+        {
+            if(!_jobs.front()._ciphered)
+            {
+                cipher();
+            }
+
+            Job job = std::move(_jobs.front());
+            _jobs.pop_front();
+
+            cleanMemoryUnder(job._key);
+
+            if(job._owner)
+            {
+                Bytes frame;
+                frame.end().write(job._data.data(), static_cast<uint32>(job._data.size()));
+                job._owner->batchCiphered(std::move(frame));
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void BatchCipher::cancel(stages::out::Ciphering* owner)
+    {
+        for(Job& job : _jobs)
+        {
+            if(owner == job._owner)
+            {
+                job._owner = nullptr;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void BatchCipher::cipher()
+    {
+        std::vector<ChaChaPoly::Lane> lanes;
+        lanes.reserve(_jobs.size());
+
+        for(Job& job : _jobs)
+        {
+            if(job._ciphered || !job._owner)
+            {
+                continue;
+            }
+
+            uint32 size = static_cast<uint32>(job._data.size());
+            job._data.resize(size + ChaChaPoly::_macSize);
+
+            lanes.push_back(ChaChaPoly::Lane
+            {
+                ._key       = job._key,
+                ._nonce     = job._nonce,
+                ._ad        = job._ad,
+                ._adSize    = sizeof(job._ad),
+                ._data      = job._data.data(),
+                ._size      = size,
+                ._tag       = job._data.data() + size,
+            });
+
+            job._ciphered = true;
+        }
+
+        if(!lanes.empty())
+        {
+            ChaChaPoly::encipherLanes(lanes.data(), static_cast<uint32>(lanes.size()));
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "pch.hpp"
+#include "chachaPoly.hpp"
+
+namespace dci::module::stiac::stages::out
+{
+    class Ciphering;
+}
+
+namespace dci::module::stiac::crypto
+{
+    /* Пакетное шифрование кадров многих соединений.
+     *
+     * Исходящие кадры копятся в течение такта и шифруются разом многодорожечным ядром
+     * ChaChaPoly::encipherLanes. Ключ, нонс и AD снимаются с соединения в момент постановки,
+     * поэтому их семантика та же что и при немедленном шифровании.
+     *
+     * Один экземпляр на поток, живет пока есть хоть один подключенный шифровальщик.
+     */
+    class BatchCipher
+        : public std::enable_shared_from_this<BatchCipher>
+    {
+    public:
+        static constexpr uint32 _maxFrameSize = 1024*4;
+
+        struct Job
+        {
+            stages::out::Ciphering *    _owner = nullptr;
+            uint32                      _key[8] {};
+            uint8                       _nonce[12] {};
+            uint8                       _ad[64] {};
+            std::vector<uint8>          _data;
+            bool                        _ciphered = false;
+        };
+
+    public:
+        BatchCipher();
+        ~BatchCipher();
+
+        static std::shared_ptr<BatchCipher> attach();
+
+        Job& enqueue(stages::out::Ciphering* owner);
+        void flush();
+        void cancel(stages::out::Ciphering* owner);
+
+    private:
+        void cipher();
+
+    private:
+        std::deque<Job> _jobs;
+        poll::Timer     _ticker{std::chrono::milliseconds{0}, false, [this]{flush();}};
+    };
+
+    using BatchCipherPtr = std::shared_ptr<BatchCipher>;
+}
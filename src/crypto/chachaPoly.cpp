@@ -0,0 +1,862 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "chachaPoly.hpp"
+#include "secret.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#   include <immintrin.h>
+#   define CHACHAPOLY_AVX2 1
+#   define CHACHAPOLY_TARGET __attribute__((target("avx2")))
+#else
+#   define CHACHAPOLY_AVX2 0
+#endif
+
+namespace dci::module::stiac::crypto
+{
+    namespace
+    {
+        std::atomic<bool> accelerationAllowed {true};
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        inline uint32 le32(const uint8* p)
+        {
+            return uint32(p[0]) | (uint32(p[1])<<8) | (uint32(p[2])<<16) | (uint32(p[3])<<24);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        inline void le32(uint8* p, uint32 v)
+        {
+            p[0] = static_cast<uint8>(v);
+            p[1] = static_cast<uint8>(v>>8);
+            p[2] = static_cast<uint8>(v>>16);
+            p[3] = static_cast<uint8>(v>>24);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        inline uint32 rotl(uint32 v, int n)
+        {
+            return (v << n) | (v >> (32-n));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        inline void quarterRound(uint32& a, uint32& b, uint32& c, uint32& d)
+        {
+            a += b; d ^= a; d = rotl(d, 16);
+            c += d; b ^= c; b = rotl(b, 12);
+            a += b; d ^= a; d = rotl(d, 8);
+            c += d; b ^= c; b = rotl(b, 7);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void chachaBlock(const uint32 state[16], uint8 out[64])
+        {
+            uint32 x[16];
+            for(int i(0); i<16; ++i) x[i] = state[i];
+
+            for(int i(0); i<10; ++i)
+            {
+                quarterRound(x[0], x[4], x[ 8], x[12]);
+                quarterRound(x[1], x[5], x[ 9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[ 8], x[13]);
+                quarterRound(x[3], x[4], x[ 9], x[14]);
+            }
+
+            for(int i(0); i<16; ++i) le32(out + i*4, x[i] + state[i]);
+
+            cleanMemoryUnder(x);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //h = h * r (mod 2^130-5), неполная редукция
+        void polyMul(uint32 h[5], const uint32 r[5])
+        {
+            const uint32 s1 = r[1]*5, s2 = r[2]*5, s3 = r[3]*5, s4 = r[4]*5;
+
+            uint64 d0 = uint64(h[0])*r[0] + uint64(h[1])*s4   + uint64(h[2])*s3   + uint64(h[3])*s2   + uint64(h[4])*s1;
+            uint64 d1 = uint64(h[0])*r[1] + uint64(h[1])*r[0] + uint64(h[2])*s4   + uint64(h[3])*s3   + uint64(h[4])*s2;
+            uint64 d2 = uint64(h[0])*r[2] + uint64(h[1])*r[1] + uint64(h[2])*r[0] + uint64(h[3])*s4   + uint64(h[4])*s3;
+            uint64 d3 = uint64(h[0])*r[3] + uint64(h[1])*r[2] + uint64(h[2])*r[1] + uint64(h[3])*r[0] + uint64(h[4])*s4;
+            uint64 d4 = uint64(h[0])*r[4] + uint64(h[1])*r[3] + uint64(h[2])*r[2] + uint64(h[3])*r[1] + uint64(h[4])*r[0];
+
+            uint64 c;
+            c = d0 >> 26; h[0] = d0 & 0x3ffffff; d1 += c;
+            c = d1 >> 26; h[1] = d1 & 0x3ffffff; d2 += c;
+            c = d2 >> 26; h[2] = d2 & 0x3ffffff; d3 += c;
+            c = d3 >> 26; h[3] = d3 & 0x3ffffff; d4 += c;
+            c = d4 >> 26; h[4] = d4 & 0x3ffffff;
+            h[0] += static_cast<uint32>(c*5);
+            c = h[0] >> 26; h[0] &= 0x3ffffff;
+            h[1] += static_cast<uint32>(c);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void polyBlocks(uint32 h[5], const uint32 r[5], const uint8* m, uint32 blocks, uint32 hibit)
+        {
+            for(; blocks; --blocks, m += 16)
+            {
+                h[0] += (le32(m+ 0)     ) & 0x3ffffff;
+                h[1] += (le32(m+ 3) >> 2) & 0x3ffffff;
+                h[2] += (le32(m+ 6) >> 4) & 0x3ffffff;
+                h[3] += (le32(m+ 9) >> 6) & 0x3ffffff;
+                h[4] += (le32(m+12) >> 8) | hibit;
+
+                polyMul(h, r);
+            }
+        }
+
+#if CHACHAPOLY_AVX2
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHACHAPOLY_TARGET inline __m256i rotl16(__m256i v)
+        {
+            return _mm256_shuffle_epi8(v, _mm256_set_epi8(13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2,
+                                                          13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHACHAPOLY_TARGET inline __m256i rotl8(__m256i v)
+        {
+            return _mm256_shuffle_epi8(v, _mm256_set_epi8(14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3,
+                                                          14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        template <int n>
+        CHACHAPOLY_TARGET inline __m256i rotl(__m256i v)
+        {
+            return _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32-n));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHACHAPOLY_TARGET inline void quarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+        {
+            a = _mm256_add_epi32(a, b); d = rotl16(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d); b = rotl<12>(_mm256_xor_si256(b, c));
+            a = _mm256_add_epi32(a, b); d = rotl8(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d); b = rotl<7>(_mm256_xor_si256(b, c));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //транспонирование 8x8 слов: на входе слово i восьми блоков, на выходе 8 слов блока i
+        CHACHAPOLY_TARGET inline void transpose8(__m256i x[8])
+        {
+            __m256i a[8], b[8];
+            for(int i(0); i<8; i+=2)
+            {
+                a[i+0] = _mm256_unpacklo_epi32(x[i], x[i+1]);
+                a[i+1] = _mm256_unpackhi_epi32(x[i], x[i+1]);
+            }
+
+            for(int i(0); i<8; i+=4)
+            {
+                b[i+0] = _mm256_unpacklo_epi64(a[i+0], a[i+2]);
+                b[i+1] = _mm256_unpackhi_epi64(a[i+0], a[i+2]);
+                b[i+2] = _mm256_unpacklo_epi64(a[i+1], a[i+3]);
+                b[i+3] = _mm256_unpackhi_epi64(a[i+1], a[i+3]);
+            }
+
+            for(int i(0); i<4; ++i)
+            {
+                x[i+0] = _mm256_permute2x128_si256(b[i], b[i+4], 0x20);
+                x[i+4] = _mm256_permute2x128_si256(b[i], b[i+4], 0x31);
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //8 блоков за проход, в регистре i - слово i всех восьми блоков
+        CHACHAPOLY_TARGET void chacha8Blocks(const uint32 state[16], const uint8* src, uint8* dst, uint32 groups)
+        {
+            __m256i counter = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(state[12])), _mm256_set_epi32(7,6,5,4,3,2,1,0));
+
+            for(; groups; --groups)
+            {
+                __m256i x[16];
+                for(int i(0); i<16; ++i)
+                {
+                    x[i] = _mm256_set1_epi32(static_cast<int>(state[i]));
+                }
+                x[12] = counter;
+
+                for(int i(0); i<10; ++i)
+                {
+                    quarterRound(x[0], x[4], x[ 8], x[12]);
+                    quarterRound(x[1], x[5], x[ 9], x[13]);
+                    quarterRound(x[2], x[6], x[10], x[14]);
+                    quarterRound(x[3], x[7], x[11], x[15]);
+
+                    quarterRound(x[0], x[5], x[10], x[15]);
+                    quarterRound(x[1], x[6], x[11], x[12]);
+                    quarterRound(x[2], x[7], x[ 8], x[13]);
+                    quarterRound(x[3], x[4], x[ 9], x[14]);
+                }
+
+                for(int i(0); i<16; ++i)
+                {
+                    x[i] = _mm256_add_epi32(x[i], 12 == i ? counter : _mm256_set1_epi32(static_cast<int>(state[i])));
+                }
+
+                transpose8(x);
+                transpose8(x+8);
+
+                const __m256i* in = reinterpret_cast<const __m256i*>(src);
+                __m256i* out = reinterpret_cast<__m256i*>(dst);
+                for(int i(0); i<8; ++i)
+                {
+                    _mm256_storeu_si256(out + i*2 + 0, _mm256_xor_si256(_mm256_loadu_si256(in + i*2 + 0), x[i]));
+                    _mm256_storeu_si256(out + i*2 + 1, _mm256_xor_si256(_mm256_loadu_si256(in + i*2 + 1), x[i+8]));
+                }
+
+                counter = _mm256_add_epi32(counter, _mm256_set1_epi32(8));
+                src += 512;
+                dst += 512;
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //8 независимых состояний (дорожек), у всех блок номер counter
+        CHACHAPOLY_TARGET void chachaLanes8(const uint32 states[8][16], uint32 counter, uint8 out[8][64])
+        {
+            __m256i x[16], x0[16];
+            for(int i(0); i<16; ++i)
+            {
+                x[i] = x0[i] = _mm256_set_epi32(
+                    static_cast<int>(states[7][i]), static_cast<int>(states[6][i]),
+                    static_cast<int>(states[5][i]), static_cast<int>(states[4][i]),
+                    static_cast<int>(states[3][i]), static_cast<int>(states[2][i]),
+                    static_cast<int>(states[1][i]), static_cast<int>(states[0][i]));
+            }
+            x[12] = x0[12] = _mm256_set1_epi32(static_cast<int>(counter));
+
+            for(int i(0); i<10; ++i)
+            {
+                quarterRound(x[0], x[4], x[ 8], x[12]);
+                quarterRound(x[1], x[5], x[ 9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[ 8], x[13]);
+                quarterRound(x[3], x[4], x[ 9], x[14]);
+            }
+
+            for(int i(0); i<16; ++i)
+            {
+                x[i] = _mm256_add_epi32(x[i], x0[i]);
+            }
+
+            transpose8(x);
+            transpose8(x+8);
+
+            for(int i(0); i<8; ++i)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[i]) + 0, x[i]);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[i]) + 1, x[i+8]);
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHACHAPOLY_TARGET inline void polyMul4(__m256i h[5], const __m256i r[5], const __m256i s[5])
+        {
+            __m256i d0 = _mm256_mul_epu32(h[0], r[0]);
+            __m256i d1 = _mm256_mul_epu32(h[0], r[1]);
+            __m256i d2 = _mm256_mul_epu32(h[0], r[2]);
+            __m256i d3 = _mm256_mul_epu32(h[0], r[3]);
+            __m256i d4 = _mm256_mul_epu32(h[0], r[4]);
+
+            d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(h[1], s[4]));
+            d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(h[1], r[0]));
+            d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(h[1], r[1]));
+            d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(h[1], r[2]));
+            d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(h[1], r[3]));
+
+            d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(h[2], s[3]));
+            d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(h[2], s[4]));
+            d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(h[2], r[0]));
+            d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(h[2], r[1]));
+            d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(h[2], r[2]));
+
+            d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(h[3], s[2]));
+            d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(h[3], s[3]));
+            d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(h[3], s[4]));
+            d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(h[3], r[0]));
+            d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(h[3], r[1]));
+
+            d0 = _mm256_add_epi64(d0, _mm256_mul_epu32(h[4], s[1]));
+            d1 = _mm256_add_epi64(d1, _mm256_mul_epu32(h[4], s[2]));
+            d2 = _mm256_add_epi64(d2, _mm256_mul_epu32(h[4], s[3]));
+            d3 = _mm256_add_epi64(d3, _mm256_mul_epu32(h[4], s[4]));
+            d4 = _mm256_add_epi64(d4, _mm256_mul_epu32(h[4], r[0]));
+
+            const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+            __m256i c;
+            c = _mm256_srli_epi64(d0, 26); h[0] = _mm256_and_si256(d0, mask); d1 = _mm256_add_epi64(d1, c);
+            c = _mm256_srli_epi64(d1, 26); h[1] = _mm256_and_si256(d1, mask); d2 = _mm256_add_epi64(d2, c);
+            c = _mm256_srli_epi64(d2, 26); h[2] = _mm256_and_si256(d2, mask); d3 = _mm256_add_epi64(d3, c);
+            c = _mm256_srli_epi64(d3, 26); h[3] = _mm256_and_si256(d3, mask); d4 = _mm256_add_epi64(d4, c);
+            c = _mm256_srli_epi64(d4, 26); h[4] = _mm256_and_si256(d4, mask);
+            h[0] = _mm256_add_epi64(h[0], _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+            c = _mm256_srli_epi64(h[0], 26); h[0] = _mm256_and_si256(h[0], mask);
+            h[1] = _mm256_add_epi64(h[1], c);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //4 блока по 16 байт в лимбы, блок i в 64-битной дорожке i
+        CHACHAPOLY_TARGET inline void polyLoad4(const uint8* m, __m256i l[5])
+        {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m+32));
+
+            __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(v0, v1), 0xd8);
+            __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(v0, v1), 0xd8);
+
+            const __m256i mask = _mm256_set1_epi64x(0x3ffffff);
+            l[0] = _mm256_and_si256(lo, mask);
+            l[1] = _mm256_and_si256(_mm256_srli_epi64(lo, 26), mask);
+            l[2] = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask);
+            l[3] = _mm256_and_si256(_mm256_srli_epi64(hi, 14), mask);
+            l[4] = _mm256_or_si256(_mm256_srli_epi64(hi, 40), _mm256_set1_epi64x(1<<24));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //blocks кратно 4
+        CHACHAPOLY_TARGET void polyBlocks4(uint32 h[5], const uint32 r[4][5], const uint8* m, uint32 blocks)
+        {
+            __m256i acc[5];
+            polyLoad4(m, acc);
+            m += 64;
+            blocks -= 4;
+
+            acc[0] = _mm256_add_epi64(acc[0], _mm256_set_epi64x(0, 0, 0, h[0]));
+            acc[1] = _mm256_add_epi64(acc[1], _mm256_set_epi64x(0, 0, 0, h[1]));
+            acc[2] = _mm256_add_epi64(acc[2], _mm256_set_epi64x(0, 0, 0, h[2]));
+            acc[3] = _mm256_add_epi64(acc[3], _mm256_set_epi64x(0, 0, 0, h[3]));
+            acc[4] = _mm256_add_epi64(acc[4], _mm256_set_epi64x(0, 0, 0, h[4]));
+
+            //все дорожки умножаются на r^4
+            __m256i r4[5], s4[5];
+            for(int i(0); i<5; ++i)
+            {
+                r4[i] = _mm256_set1_epi64x(r[3][i]);
+                s4[i] = _mm256_set1_epi64x(r[3][i]*5);
+            }
+
+            for(; blocks; blocks -= 4, m += 64)
+            {
+                polyMul4(acc, r4, s4);
+
+                __m256i l[5];
+                polyLoad4(m, l);
+                for(int i(0); i<5; ++i)
+                {
+                    acc[i] = _mm256_add_epi64(acc[i], l[i]);
+                }
+            }
+
+            //сведение: дорожка i умножается на r^(4-i)
+            __m256i rf[5], sf[5];
+            for(int i(0); i<5; ++i)
+            {
+                rf[i] = _mm256_set_epi64x(r[0][i], r[1][i], r[2][i], r[3][i]);
+                sf[i] = _mm256_set_epi64x(r[0][i]*5, r[1][i]*5, r[2][i]*5, r[3][i]*5);
+            }
+            polyMul4(acc, rf, sf);
+
+            uint64 sum[5];
+            for(int i(0); i<5; ++i)
+            {
+                alignas(32) uint64 lanes[4];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc[i]);
+                sum[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+
+            uint64 c;
+            c = sum[0] >> 26; h[0] = sum[0] & 0x3ffffff; sum[1] += c;
+            c = sum[1] >> 26; h[1] = sum[1] & 0x3ffffff; sum[2] += c;
+            c = sum[2] >> 26; h[2] = sum[2] & 0x3ffffff; sum[3] += c;
+            c = sum[3] >> 26; h[3] = sum[3] & 0x3ffffff; sum[4] += c;
+            c = sum[4] >> 26; h[4] = sum[4] & 0x3ffffff;
+            h[0] += static_cast<uint32>(c*5);
+            c = h[0] >> 26; h[0] &= 0x3ffffff;
+            h[1] += static_cast<uint32>(c);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        bool avx2()
+        {
+            static const bool res = __builtin_cpu_supports("avx2");
+            return res && accelerationAllowed.load(std::memory_order_relaxed);
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ChaChaPoly::ChaChaPoly()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ChaChaPoly::~ChaChaPoly()
+    {
+        clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ChaChaPoly::available()
+    {
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::setAccelerated(bool enable)
+    {
+        accelerationAllowed.store(enable, std::memory_order_relaxed);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::setMacOnly(bool macOnly)
+    {
+        _macOnly = macOnly;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::setKey(const void* key, uint32 keySize)
+    {
+        dbgAssert(_keySize == keySize);
+        (void)keySize;
+
+        for(int i(0); i<8; ++i)
+        {
+            _key[i] = le32(static_cast<const uint8*>(key) + i*4);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::setAd(const void* ad, uint32 adSize)
+    {
+        dbgAssert(adSize <= _maxAdSize);
+        _adSize = std::min(adSize, _maxAdSize);
+        std::memcpy(_ad, ad, _adSize);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::start(const void* nonce, uint32 nonceSize)
+    {
+        dbgAssert(8 == nonceSize || 12 == nonceSize);
+
+        uint8 n[12] {};
+        std::memcpy(n + 12 - nonceSize, nonce, nonceSize);
+
+        _state[0] = 0x61707865;
+        _state[1] = 0x3320646e;
+        _state[2] = 0x79622d32;
+        _state[3] = 0x6b206574;
+        for(int i(0); i<8; ++i) _state[4+i] = _key[i];
+        _state[12] = 0;
+        _state[13] = le32(n+0);
+        _state[14] = le32(n+4);
+        _state[15] = le32(n+8);
+
+        //ключ poly1305 - первые 32 байта нулевого блока
+        uint8 block0[_blockSize];
+        chachaBlock(_state, block0);
+        polyInit(block0);
+        cleanMemoryUnder(block0);
+
+        _state[12] = 1;
+        _keyStreamPos = _blockSize;
+
+        polyUpdate(_ad, _adSize);
+        polyPad();
+        _textSize = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::encipher(const void* src, void* dst, uint32 size)
+    {
+        if(_macOnly)
+        {
+            if(src != dst)
+            {
+                std::memmove(dst, src, size);
+            }
+        }
+        else
+        {
+            keyStreamXor(static_cast<const uint8*>(src), static_cast<uint8*>(dst), size);
+        }
+
+        polyUpdate(static_cast<const uint8*>(dst), size);
+        _textSize += size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::decipher(const void* src, void* dst, uint32 size)
+    {
+        polyUpdate(static_cast<const uint8*>(src), size);
+
+        if(_macOnly)
+        {
+            if(src != dst)
+            {
+                std::memmove(dst, src, size);
+            }
+        }
+        else
+        {
+            keyStreamXor(static_cast<const uint8*>(src), static_cast<uint8*>(dst), size);
+        }
+
+        _textSize += size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::encipherFinish(void* macOut)
+    {
+        finish(static_cast<uint8*>(macOut));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ChaChaPoly::decipherFinish(const void* macIn)
+    {
+        uint8 tag[_macSize];
+        finish(tag);
+
+        const uint8* expected = static_cast<const uint8*>(macIn);
+        uint8 diff = 0;
+        for(uint32 i(0); i<_macSize; ++i)
+        {
+            diff |= tag[i] ^ expected[i];
+        }
+
+        cleanMemoryUnder(tag);
+        return 0 == diff;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::clear()
+    {
+        cleanMemoryUnder(_key);
+        cleanMemoryUnder(_state);
+        cleanMemoryUnder(_keyStream);
+        _keyStreamPos = _blockSize;
+        cleanMemoryUnder(_r);
+        cleanMemoryUnder(_s);
+        cleanMemoryUnder(_h);
+        cleanMemoryUnder(_polyBuffer);
+        _polyBufferSize = 0;
+        cleanMemoryUnder(_ad);
+        _adSize = 0;
+        _textSize = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const uint32* ChaChaPoly::keyWords() const
+    {
+        return _key;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::encipherLanes(Lane* lanes, uint32 amount)
+    {
+        for(uint32 base(0); base<amount; base += _lanesWidth)
+        {
+            Lane* group = lanes + base;
+            uint32 groupSize = std::min(_lanesWidth, amount - base);
+
+            uint32 states[_lanesWidth][16];
+            uint8 polyKeys[_lanesWidth][32];
+            uint32 maxBlocks = 0;
+
+            for(uint32 l(0); l<_lanesWidth; ++l)
+            {
+                //недостающие дорожки дублируют первую
+                const Lane& lane = group[l < groupSize ? l : 0];
+
+                states[l][0] = 0x61707865;
+                states[l][1] = 0x3320646e;
+                states[l][2] = 0x79622d32;
+                states[l][3] = 0x6b206574;
+                for(int i(0); i<8; ++i) states[l][4+i] = lane._key[i];
+                states[l][12] = 0;
+                states[l][13] = le32(lane._nonce+0);
+                states[l][14] = le32(lane._nonce+4);
+                states[l][15] = le32(lane._nonce+8);
+
+                maxBlocks = std::max(maxBlocks, 1 + (lane._size + _blockSize - 1) / _blockSize);
+            }
+
+            //блок 0 - ключ poly1305, далее гамма
+            for(uint32 counter(0); counter<maxBlocks; ++counter)
+            {
+                alignas(32) uint8 keyStream[_lanesWidth][_blockSize];
+
+#if CHACHAPOLY_AVX2
+                if(avx2())
+                {
+                    chachaLanes8(states, counter, keyStream);
+                }
+                else
+#endif
+                {
+                    for(uint32 l(0); l<groupSize; ++l)
+                    {
+                        states[l][12] = counter;
+                        chachaBlock(states[l], keyStream[l]);
+                    }
+                }
+
+                for(uint32 l(0); l<groupSize; ++l)
+                {
+                    Lane& lane = group[l];
+
+                    if(!counter)
+                    {
+                        std::memcpy(polyKeys[l], keyStream[l], sizeof(polyKeys[l]));
+                        continue;
+                    }
+
+                    uint32 offset = (counter-1) * _blockSize;
+                    if(offset >= lane._size)
+                    {
+                        continue;
+                    }
+
+                    uint32 size = std::min(_blockSize, lane._size - offset);
+                    for(uint32 i(0); i<size; ++i)
+                    {
+                        lane._data[offset+i] ^= keyStream[l][i];
+                    }
+                }
+
+                cleanMemoryUnder(keyStream);
+            }
+
+            for(uint32 l(0); l<groupSize; ++l)
+            {
+                Lane& lane = group[l];
+
+                ChaChaPoly poly;
+                poly.polyInit(polyKeys[l]);
+                poly.polyUpdate(lane._ad, lane._adSize);
+                poly.polyPad();
+                poly.polyUpdate(lane._data, lane._size);
+                poly._adSize = lane._adSize;
+                poly._textSize = lane._size;
+                poly.finish(lane._tag);
+            }
+
+            cleanMemoryUnder(states);
+            cleanMemoryUnder(polyKeys);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::keyStreamXor(const uint8* src, uint8* dst, uint32 size)
+    {
+        //остаток гаммы от прошлой порции
+        while(size && _keyStreamPos < _blockSize)
+        {
+            *dst++ = *src++ ^ _keyStream[_keyStreamPos++];
+            --size;
+        }
+
+#if CHACHAPOLY_AVX2
+        if(size >= 8*_blockSize && avx2())
+        {
+            uint32 groups = size / (8*_blockSize);
+            chacha8Blocks(_state, src, dst, groups);
+            _state[12] += groups * 8;
+
+            src += groups * 8*_blockSize;
+            dst += groups * 8*_blockSize;
+            size -= groups * 8*_blockSize;
+        }
+#endif
+
+        while(size >= _blockSize)
+        {
+            chachaBlock(_state, _keyStream);
+            _state[12]++;
+
+            for(uint32 i(0); i<_blockSize; ++i)
+            {
+                dst[i] = src[i] ^ _keyStream[i];
+            }
+
+            src += _blockSize;
+            dst += _blockSize;
+            size -= _blockSize;
+        }
+
+        if(size)
+        {
+            chachaBlock(_state, _keyStream);
+            _state[12]++;
+
+            for(uint32 i(0); i<size; ++i)
+            {
+                dst[i] = src[i] ^ _keyStream[i];
+            }
+            _keyStreamPos = size;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::polyInit(const uint8 key[32])
+    {
+        _r[0][0] = (le32(key+ 0)     ) & 0x3ffffff;
+        _r[0][1] = (le32(key+ 3) >> 2) & 0x3ffff03;
+        _r[0][2] = (le32(key+ 6) >> 4) & 0x3ffc0ff;
+        _r[0][3] = (le32(key+ 9) >> 6) & 0x3f03fff;
+        _r[0][4] = (le32(key+12) >> 8) & 0x00fffff;
+
+        for(int i(1); i<4; ++i)
+        {
+            std::memcpy(_r[i], _r[i-1], sizeof(_r[i]));
+            polyMul(_r[i], _r[0]);
+        }
+
+        for(int i(0); i<4; ++i)
+        {
+            _s[i] = le32(key + 16 + i*4);
+        }
+
+        std::memset(_h, 0, sizeof(_h));
+        _polyBufferSize = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::polyUpdate(const uint8* data, uint32 size)
+    {
+        if(_polyBufferSize)
+        {
+            uint32 amount = std::min(_polyBlockSize - _polyBufferSize, size);
+            std::memcpy(_polyBuffer + _polyBufferSize, data, amount);
+            _polyBufferSize += amount;
+            data += amount;
+            size -= amount;
+
+            if(_polyBufferSize < _polyBlockSize)
+            {
+                return;
+            }
+
+            polyBlocks(_h, _r[0], _polyBuffer, 1, 1<<24);
+            _polyBufferSize = 0;
+        }
+
+#if CHACHAPOLY_AVX2
+        if(size >= 16*_polyBlockSize && avx2())
+        {
+            uint32 blocks = (size / (4*_polyBlockSize)) * 4;
+            polyBlocks4(_h, _r, data, blocks);
+            data += blocks * _polyBlockSize;
+            size -= blocks * _polyBlockSize;
+        }
+#endif
+
+        if(size >= _polyBlockSize)
+        {
+            uint32 blocks = size / _polyBlockSize;
+            polyBlocks(_h, _r[0], data, blocks, 1<<24);
+            data += blocks * _polyBlockSize;
+            size -= blocks * _polyBlockSize;
+        }
+
+        if(size)
+        {
+            std::memcpy(_polyBuffer, data, size);
+            _polyBufferSize = size;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::polyPad()
+    {
+        if(_polyBufferSize)
+        {
+            std::memset(_polyBuffer + _polyBufferSize, 0, _polyBlockSize - _polyBufferSize);
+            polyBlocks(_h, _r[0], _polyBuffer, 1, 1<<24);
+            _polyBufferSize = 0;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::polyFinish(uint8 tag[_macSize])
+    {
+        uint32 h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+        uint32 c;
+
+        c = h1 >> 26; h1 &= 0x3ffffff;
+        h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+        h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+        h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+        h0 += c*5; c = h0 >> 26; h0 &= 0x3ffffff;
+        h1 += c;
+
+        //h - p
+        uint32 g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+        uint32 g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+        uint32 g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+        uint32 g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+        uint32 g4 = h4 + c - (1u << 26);
+
+        uint32 mask = (g4 >> 31) - 1;
+        g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+        mask = ~mask;
+        h0 = (h0 & mask) | g0;
+        h1 = (h1 & mask) | g1;
+        h2 = (h2 & mask) | g2;
+        h3 = (h3 & mask) | g3;
+        h4 = (h4 & mask) | g4;
+
+        h0 = (h0      ) | (h1 << 26);
+        h1 = (h1 >>  6) | (h2 << 20);
+        h2 = (h2 >> 12) | (h3 << 14);
+        h3 = (h3 >> 18) | (h4 <<  8);
+
+        uint64 f;
+        f = uint64(h0) + _s[0];             h0 = static_cast<uint32>(f);
+        f = uint64(h1) + _s[1] + (f >> 32); h1 = static_cast<uint32>(f);
+        f = uint64(h2) + _s[2] + (f >> 32); h2 = static_cast<uint32>(f);
+        f = uint64(h3) + _s[3] + (f >> 32); h3 = static_cast<uint32>(f);
+
+        le32(tag+ 0, h0);
+        le32(tag+ 4, h1);
+        le32(tag+ 8, h2);
+        le32(tag+12, h3);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ChaChaPoly::finish(uint8 tag[_macSize])
+    {
+        polyPad();
+
+        uint8 lengths[_polyBlockSize];
+        le32(lengths+ 0, _adSize);
+        le32(lengths+ 4, 0);
+        le32(lengths+ 8, static_cast<uint32>(_textSize));
+        le32(lengths+12, static_cast<uint32>(_textSize >> 32));
+        polyUpdate(lengths, sizeof(lengths));
+
+        polyFinish(tag);
+
+        cleanMemoryUnder(_h);
+        cleanMemoryUnder(_keyStream);
+        _keyStreamPos = _blockSize;
+    }
+}
+
+#undef CHACHAPOLY_TARGET
+#undef CHACHAPOLY_AVX2
@@ -0,0 +1,265 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "dhPool.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace dci::module::stiac::crypto
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    class DhPool::Workers
+    {
+    public:
+        static Workers& instance()
+        {
+            static Workers instance;
+            return instance;
+        }
+
+        void push(JobPtr job)
+        {
+            {
+                std::unique_lock lock(_mtx);
+                _queue.push_back(std::move(job));
+            }
+            _cv.notify_one();
+        }
+
+    private:
+        Workers()
+        {
+            //один поток остается соединениям
+            unsigned amount = std::thread::hardware_concurrency();
+            amount = amount > 2 ? amount - 1 : 1;
+
+            for(unsigned i(0); i<amount; ++i)
+            {
+                _threads.emplace_back([this]{work();});
+            }
+        }
+
+        ~Workers()
+        {
+            {
+                std::unique_lock lock(_mtx);
+                _stop = true;
+            }
+            _cv.notify_all();
+
+            for(std::thread& t : _threads)
+            {
+                t.join();
+            }
+        }
+
+        void work()
+        {
+            std::unique_lock lock(_mtx);
+
+            for(;;)
+            {
+                _cv.wait(lock, [this]{return _stop || !_queue.empty();});
+                if(_stop)
+                {
+                    return;
+                }
+
+                JobPtr job = std::move(_queue.front());
+                _queue.pop_front();
+
+                lock.unlock();
+                job->compute();
+                job.reset();
+                lock.lock();
+            }
+        }
+
+    private:
+        std::mutex                  _mtx;
+        std::condition_variable     _cv;
+        std::deque<JobPtr>          _queue;
+        bool                        _stop = false;
+        std::vector<std::thread>    _threads;
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void DhPool::Job::compute()
+    {
+        dci::crypto::curve25519::donna(_remote.data(), _private.data(), _shared.data());
+        cleanMemoryUnder(_private.data(), _private.size());
+
+        uint8 sum = 0;
+        for(uint8 v : _shared)
+        {
+            sum |= v;
+        }
+        _zero = !sum;
+
+        _ready.store(true, std::memory_order_release);
+        _wakeup->notify();
+        _wakeup.reset();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    DhPool::Wakeup::Wakeup(int fd)
+        : _fd{fd}
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    DhPool::Wakeup::~Wakeup()
+    {
+        if(0 <= _fd)
+        {
+            ::close(_fd);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void DhPool::Wakeup::notify()
+    {
+        //счетчик eventfd копится, переполнение на практике недостижимо
+        uint64 one = 1;
+        [[maybe_unused]] ssize_t res = ::write(_fd, &one, sizeof(one));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    DhPool::DhPool()
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(0 > fd)
+        {
+            return;
+        }
+
+        //рабочие потоки пишут в свою копию: задание может пережить пул, а дескриптор пула закрывается с ним
+        int dup = ::dup(fd);
+        if(0 > dup)
+        {
+            ::close(fd);
+            return;
+        }
+
+        _wakeup = std::make_shared<Wakeup>(dup);
+        _descriptor = poll::Descriptor{fd};
+
+        _descriptor.readyEvent() += _sol * [this](int fd, std::uint_fast32_t)
+        {
+            uint64 counter;
+            [[maybe_unused]] ssize_t res = ::read(fd, &counter, sizeof(counter));
+            _descriptor.resetReadyState(poll::Descriptor::rsf_read);
+
+            complete();
+        };
+
+        if(_descriptor.install())
+        {
+            _descriptor.close();
+            _wakeup.reset();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    DhPool::~DhPool()
+    {
+        _sol.flush();
+
+        //рабочие потоки могут еще держать задания, владельцам результат уже не нужен
+        for(JobPtr& job : _jobs)
+        {
+            job->_done = nullptr;
+        }
+        _jobs.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::shared_ptr<DhPool> DhPool::attach()
+    {
+        static thread_local std::weak_ptr<DhPool> instance;
+
+        std::shared_ptr<DhPool> res = instance.lock();
+        if(!res)
+        {
+            res = std::make_shared<DhPool>();
+            if(!res->_wakeup)
+            {
+                return nullptr;
+            }
+
+            instance = res;
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void DhPool::submit(const void* owner, const uint8 remote[_keySize], const uint8 local[_keySize], Done&& done)
+    {
+        JobPtr job = std::make_shared<Job>();
+        job->_owner = owner;
+        std::memcpy(job->_remote.data(), remote, _keySize);
+        std::memcpy(job->_private.data(), local, _keySize);
+        job->_wakeup = _wakeup;
+        job->_done = std::move(done);
+
+        _jobs.push_back(job);
+        Workers::instance().push(std::move(job));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void DhPool::cancel(const void* owner)
+    {
+        //задания остаются в очереди, только без выдачи
+        for(JobPtr& job : _jobs)
+        {
+            if(owner == job->_owner)
+            {
+                job->_done = nullptr;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void DhPool::complete()
+    {
+        auto lifeLocker = shared_from_this();
+
+        //готовое выдается без оглядки на чужие задания, но не раньше неготового того же владельца
+        std::vector<JobPtr> ready;
+        std::vector<const void*> waiting;
+
+        for(auto iter = _jobs.begin(); iter != _jobs.end(); )
+        {
+            const void* owner = (*iter)->_owner;
+
+            if(!(*iter)->_ready.load(std::memory_order_acquire) ||
+               waiting.end() != std::find(waiting.begin(), waiting.end(), owner))
+            {
+                waiting.push_back(owner);
+                ++iter;
+                continue;
+            }
+
+            ready.push_back(std::move(*iter));
+            iter = _jobs.erase(iter);
+        }
+
+        //выдача может ставить новые задания
+        for(JobPtr& job : ready)
+        {
+            if(job->_done)
+            {
+                Done done = std::move(job->_done);
+                done(job->_zero ? nullptr : job->_shared.data());
+            }
+
+            cleanMemoryUnder(job->_shared.data(), job->_shared.size());
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "pch.hpp"
+#include "secret.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /* Вынос curve25519::donna с потока соединений.
+     *
+     * Вычисления идут в общем на процесс наборе рабочих потоков. Рабочий поток будит
+     * поток-владелец через eventfd, готовое выдается сразу, независимо от чужих заданий;
+     * задания одного владельца - строго в порядке постановки, на этом держится порядок
+     * смены ключей в Symmetric.
+     *
+     * Один экземпляр на поток, живет пока есть хоть одно подключенное рукопожатие.
+     */
+    class DhPool
+        : public std::enable_shared_from_this<DhPool>
+    {
+    public:
+        static constexpr uint32 _keySize = 32;
+
+        //общий секрет, nullptr если он вырожден (нулевой)
+        using Done = std::function<void(const uint8* shared)>;
+
+    public:
+        DhPool();
+        ~DhPool();
+
+        //nullptr если поток-владелец нечем будить
+        static std::shared_ptr<DhPool> attach();
+
+        void submit(const void* owner, const uint8 remote[_keySize], const uint8 local[_keySize], Done&& done);
+        void cancel(const void* owner);
+
+    private:
+        void complete();
+
+    private:
+        //копия eventfd для рабочих потоков, живет пока его держит хоть одно задание
+        struct Wakeup
+        {
+            int _fd = -1;
+
+            Wakeup(int fd);
+            ~Wakeup();
+            void notify();
+        };
+        using WakeupPtr = std::shared_ptr<Wakeup>;
+
+        struct Job
+        {
+            const void *        _owner = nullptr;
+            Secret<_keySize>    _remote;
+            Secret<_keySize>    _private;
+            Secret<_keySize>    _shared;
+            bool                _zero = false;
+            std::atomic<bool>   _ready {false};
+            WakeupPtr           _wakeup;
+            Done                _done;
+
+            void compute();
+        };
+        using JobPtr = std::shared_ptr<Job>;
+
+        class Workers;
+
+    private:
+        std::deque<JobPtr>  _jobs;
+        WakeupPtr           _wakeup;
+        poll::Descriptor    _descriptor;
+        sbs::Owner          _sol;
+    };
+
+    using DhPoolPtr = std::shared_ptr<DhPool>;
+}
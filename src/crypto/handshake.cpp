@@ -44,13 +44,21 @@ namespace dci::module::stiac::crypto
 
         _inCiphering->mixHash("dci/module/stiac/0");
         _outCiphering->mixHash("dci/module/stiac/0");
+
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Handshake::~Handshake()
     {
+        if(_dhPool)
+        {
+            _dhPool->cancel(this);
+        }
+
         cleanMemoryUnder(_authLocal);
         cleanMemoryUnder(_authRemote);
+        cleanMemoryUnder(_authRemoteKnown);
+        cleanMemoryUnder(_authLocalPublic);
 
         cleanMemoryUnder(_remoteAuthentificationInitiated);
         cleanMemoryUnder(_remoteAuthentificated);
@@ -64,6 +72,9 @@ namespace dci::module::stiac::crypto
 
         cleanMemoryUnder(_protocolMarkerSent);
 
+        cleanMemoryUnder(_localAeads);
+        cleanMemoryUnder(_aeadNegotiated);
+
         cleanMemoryUnder(_protocol);
         cleanMemoryUnder(_inCiphering);
         cleanMemoryUnder(_outCiphering);
@@ -73,10 +84,14 @@ namespace dci::module::stiac::crypto
 
         cleanMemoryUnder(_outputTrafficCounter);
         cleanMemoryUnder(_outputTrafficSize);
+
+        cleanMemoryUnder(_ticketId);
+        cleanMemoryUnder(_ticketRemote);
+        cleanMemoryUnder(_remote0Tail);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Handshake::setAuth(const Bytes& prologue, const apip::PrivateKey& local)
+    void Handshake::setAuth(const Bytes& prologue, const apip::PrivateKey& local, const apip::PublicKey& remote)
     {
         _inCiphering->resetState();
         _outCiphering->resetState();
@@ -91,6 +106,196 @@ namespace dci::module::stiac::crypto
         }
 
         _authLocal = local;
+
+        if(!isZeros(local.data(), local.size()))
+        {
+            dci::crypto::curve25519::basepoint(_authLocal.data(), _authLocalPublic.data());
+        }
+
+        _authRemoteKnown = !isZeros(remote.data(), remote.size()) && !isZeros(local.data(), local.size());
+        if(_authRemoteKnown)
+        {
+            _authRemote = remote;
+
+            //режимы не смешиваются: стороны с разными режимами не договорятся
+            _inCiphering->mixHash("dci/module/stiac/kk");
+            _outCiphering->mixHash("dci/module/stiac/kk");
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setEarlyPayload(bool enable)
+    {
+        _earlyPayload = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Handshake::inputPayloadAllowed() const
+    {
+        //после эфемерного ключа удаленной стороны входной ключ включает ee и повтор невозможен
+        return _earlyPayload || !_authRemoteKnown || _asymRemoteAge > 1;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setAeads(uint8 local)
+    {
+        //chacha20poly1305 доступен всегда, на нем идет начало рукопожатия
+        _localAeads = (local | (uint8(1) << static_cast<uint8>(Aead::Kind::chacha20poly1305))) & Aead::availableMask();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint8 Handshake::aeads() const
+    {
+        return _localAeads;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::remoteAeads(uint8 remote)
+    {
+        if(_aeadNegotiated)
+        {
+            return;
+        }
+        _aeadNegotiated = true;
+
+        //в порядке предпочтения, выбор делает отправитель для своего направления
+        static constexpr Aead::Kind preference[] =
+        {
+            //объявляется только в режиме аутентификации без шифрования
+            Aead::Kind::poly1305,
+            Aead::Kind::aes256gcm,
+            Aead::Kind::chacha20poly1305ietf,
+            Aead::Kind::chacha20poly1305,
+        };
+
+        for(Aead::Kind kind : preference)
+        {
+            uint8 bit = uint8(1) << static_cast<uint8>(kind);
+            if(!(bit & _localAeads & remote))
+            {
+                continue;
+            }
+
+            if(Aead::Kind::chacha20poly1305 == kind)
+            {
+                //уже используется
+                return;
+            }
+
+            //объявить алгоритм и сменить ключ, удаленная сторона применит его на соответствующей смене ключа
+            uint8 raw = static_cast<uint8>(kind);
+            _outCiphering->urgent(MessageType::aead, &raw, sizeof(raw));
+            _outCiphering->setPendingAead(kind);
+            _outputAead = kind;
+            applyRekeyPolicy();
+            growLocalKey();
+            return;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setRekeyPolicy(uint32 messages, uint64 bytes, uint32 seconds)
+    {
+        _paramRekeyMessages = messages;
+        _paramRekeyBytes = bytes;
+        _paramRekeySeconds = seconds;
+
+        applyRekeyPolicy();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setKeyPool(bool enable)
+    {
+        _keyPool = enable;
+
+        if(_keyPool)
+        {
+            //запустить пополнение запаса заранее
+            KeyPool::instance();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setOffload(bool enable)
+    {
+        //пул держится до конца - уже поставленное должно дойти
+        if(enable && !_dhPool)
+        {
+            _dhPool = DhPool::attach();
+        }
+
+        //без пула вычисления на месте
+        _offload = enable && _dhPool;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Handshake::rekeys() const
+    {
+        return _rekeys;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Handshake::remoteRekeys() const
+    {
+        return _remoteRekeys;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setRatchet(uint32 perDh)
+    {
+        _ratchetPerDh = perDh;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Handshake::ratchet() const
+    {
+        return _ratchetPerDh;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::remoteRatchet(bool enabled)
+    {
+        _remoteRatchet = enabled;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Handshake::ratchets() const
+    {
+        return _ratchets;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Handshake::remoteRatchets() const
+    {
+        return _remoteRatchets;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setResumption(uint32 lifetime)
+    {
+        _resumptionLifetime = lifetime;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::setResumptionTicket(const apip::ResumptionTicket& ticket)
+    {
+        _ticketPresented = !isZeros(ticket.id.data(), static_cast<uint32>(ticket.id.size()));
+        if(!_ticketPresented)
+        {
+            return;
+        }
+
+        static_assert(TicketCache::_idSize == sizeof(ticket.id));
+        static_assert(TicketCache::_secretSize == sizeof(ticket.secret));
+        std::memcpy(_ticketId.data(), ticket.id.data(), _ticketId.size());
+        std::memcpy(_ticketSecret.data(), ticket.secret.data(), _ticketSecret.size());
+        _ticketRemote = ticket.remote;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Handshake::resumed() const
+    {
+        return _resumed;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -123,6 +328,8 @@ namespace dci::module::stiac::crypto
             _remoteAuthentificationInitiated = false;
             _remoteAuthentificated = true;
             _protocol->handshakeAuthentificated();
+
+            issueTicket();
         }
     }
 
@@ -168,6 +375,51 @@ namespace dci::module::stiac::crypto
             cropLocalKey();
             break;
 
+        case MessageType::ratchet:
+            if(!_ratchetPerDh)
+            {
+                _protocol->handshakeFail("remote ratchet not allowed");
+                return;
+            }
+
+            _inCiphering->ratchet();
+            _remoteRatchets++;
+            break;
+
+        case MessageType::ticket:
+            {
+                dbgAssert(_ticketMessageSize == data.size());
+
+                apip::ResumptionTicket ticket {};
+                data.removeTo(ticket.id.data(), static_cast<uint32>(ticket.id.size()));
+                data.removeTo(&ticket.lifetime, sizeof(ticket.lifetime));
+                ticket.lifetime = stiac::serialization::fixEndian(ticket.lifetime);
+                ticket.remote = remoteAuth();
+
+                //секрет в той же точке потока, где его вывела выдавшая сторона - сразу после этого кадра
+                _inCiphering->exportSecret([this, ticket=std::move(ticket)](const uint8* secret) mutable
+                {
+                    std::memcpy(ticket.secret.data(), secret, ticket.secret.size());
+                    _protocol->handshakeResumptionTicket(std::move(ticket));
+                });
+            }
+            break;
+
+        case MessageType::aead:
+            {
+                uint8 raw = Aead::_kindsAmount;
+                if(1 != data.size() || 1 != data.removeTo(&raw, 1) ||
+                   raw >= Aead::_kindsAmount ||
+                   !((uint8(1) << raw) & _localAeads))
+                {
+                    _protocol->handshakeFail("remote selected unsupported aead");
+                    return;
+                }
+
+                _inCiphering->setPendingAead(static_cast<Aead::Kind>(raw));
+            }
+            break;
+
         default:
             _protocol->handshakeFail("bad data from remote");
         }
@@ -179,15 +431,61 @@ namespace dci::module::stiac::crypto
         _outputTrafficCounter++;
         _outputTrafficSize += size;
 
-        if(1024         <= _outputTrafficCounter ||
-           1024*1024*8  <= _outputTrafficSize)
+        if(!_asymRemoteAge)
         {
-            growLocalKey();
+            //первый пакет при известном ключе удаленной стороны, менять пока не на что
+            return;
+        }
+
+        if(_rekeyPolicy._messages <= _outputTrafficCounter ||
+           _rekeyPolicy._bytes <= _outputTrafficSize ||
+           _rekeyPolicy._interval <= std::chrono::steady_clock::now() - _outputKeyMoment)
+        {
+            rekeyLocalKey();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Handshake::outputLeaseLimit(uint32 frames, uint32 maxFrameSize)
+    {
+        dbgAssert(maxFrameSize);
+
+        auto left = [&]() -> uint64
+        {
+            if(_rekeyPolicy._messages <= _outputTrafficCounter ||
+               _rekeyPolicy._bytes <= _outputTrafficSize ||
+               _rekeyPolicy._interval <= std::chrono::steady_clock::now() - _outputKeyMoment)
+            {
+                return 0;
+            }
+
+            return std::min({
+                        uint64{frames},
+                        _rekeyPolicy._messages - _outputTrafficCounter,
+                        (_rekeyPolicy._bytes - _outputTrafficSize) / maxFrameSize});
+        };
+
+        uint64 res = left();
+        if(!res && _asymRemoteAge)
+        {
+            //порог уже достигнут, выделять на новом ключе
+            rekeyLocalKey();
+            res = left();
         }
+
+        return static_cast<uint32>(res);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Handshake::inputTraffic(uint32 size)
+    void Handshake::outputLeased(uint32 frames, uint32 maxFrameSize)
+    {
+        //смена ключа по этому счету - со следующим собственным кадром, после выделенных
+        _outputTrafficCounter += frames;
+        _outputTrafficSize += uint64{frames} * maxFrameSize;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::inputTraffic(uint64 size)
     {
         _inputTrafficCounter++;
         _inputTrafficSize += size;
@@ -203,7 +501,7 @@ namespace dci::module::stiac::crypto
         MessageType mt = MessageType::ekey;
 
         //статический или эфемерный
-        if(2 == _asymLocalAge && !_authLocal.empty())
+        if(2 == _asymLocalAge && !_authLocal.empty() && !_authRemoteKnown)
         {
             //второй ключ - статический
             kp._private = _authLocal;
@@ -219,19 +517,12 @@ namespace dci::module::stiac::crypto
         }
         else
         {
-            //эфемерный
-            do
+            //эфемерный, из готового запаса, при его исчерпании - на месте
+            if(!(_keyPool && KeyPool::instance().take(kp)) && !KeyPool::generate(kp))
             {
-                bool b = dci::crypto::rnd::generate(kp._private.data(), kp._private.size());
-                if(!b)
-                {
-                    _protocol->handshakeFail("rnd failed");
-                    return;
-                }
-
-                dci::crypto::curve25519::basepoint(kp._private.data(), kp._public.data());
+                _protocol->handshakeFail("rnd failed");
+                return;
             }
-            while(isZeros(kp._public.data(), kp._public.size()));
 
             if(1 == _asymLocalAge)
             {
@@ -244,7 +535,19 @@ namespace dci::module::stiac::crypto
             }
         }
 
-        _outCiphering->urgent(mt, kp._public.data(), kp._public.size());
+        if(MessageType::fakeNull == mt && _ticketPresented && !_authRemoteKnown)
+        {
+            //сырой ключ с флагом и номер билета
+            std::array<uint8, _publicKeySize + TicketCache::_idSize> raw;
+            std::memcpy(raw.data(), kp._public.data(), _publicKeySize);
+            raw[_publicKeySize-1] |= _resumptionFlag;
+            std::memcpy(raw.data() + _publicKeySize, _ticketId.data(), _ticketId.size());
+            _outCiphering->urgent(mt, raw.data(), static_cast<uint32>(raw.size()));
+        }
+        else
+        {
+            _outCiphering->urgent(mt, kp._public.data(), kp._public.size());
+        }
 
         if(_asymRemoteAge)
         {
@@ -257,13 +560,55 @@ namespace dci::module::stiac::crypto
                 _protocolMarkerSent = true;
             }
 
-            if(_authLocal.empty() || MessageType::skey == mt)
+            if(_authLocal.empty() || MessageType::skey == mt || _authRemoteKnown)
+            {
+                _outCiphering->allowPayload();
+            }
+        }
+        else if(_authRemoteKnown && MessageType::fakeNull == mt)
+        {
+            //ключ направления из статических, полезная нагрузка идет первым же пакетом
+            updateOutputKeyKnown();
+
+            const auto& pm = _protocol->protocolMarker();
+            _outCiphering->urgent(MessageType::protocolMarker, pm.data(), static_cast<uint32>(pm.size()));
+            _protocolMarkerSent = true;
+
+            if(_earlyPayload)
             {
                 _outCiphering->allowPayload();
             }
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::rekeyLocalKey()
+    {
+        if(_ratchetPerDh && _remoteRatchet && _ratchetsSinceDh < _ratchetPerDh)
+        {
+            ratchetLocalKey();
+            return;
+        }
+
+        _rekeys++;
+        growLocalKey();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::ratchetLocalKey()
+    {
+        //объявление уходит еще на старом ключе, удаленная сторона сделает тот же шаг после него
+        _outCiphering->urgent(MessageType::ratchet, nullptr, 0);
+        _outCiphering->ratchet();
+
+        _ratchetsSinceDh++;
+        _ratchets++;
+
+        _outputTrafficCounter = 0;
+        _outputTrafficSize = 0;
+        _outputKeyMoment = std::chrono::steady_clock::now();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Handshake::cropLocalKey()
     {
@@ -283,20 +628,70 @@ namespace dci::module::stiac::crypto
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Handshake::growRemoteKey0(bytes::Alter& data)
     {
-        uint32 amount = std::min(_publicKeySize-_asymRemote0ReceivedSize, data.size());
-        dbgAssert(amount);
+        dbgAssert(!data.atEnd());
 
-        data.removeTo(&_asymRemote[_asymRemote0ReceivedSize], amount);
-        _asymRemote0ReceivedSize += amount;
+        while(!data.atEnd() && _asymRemote0ReceivedSize < remoteKey0Size())
+        {
+            if(_asymRemote0ReceivedSize < _publicKeySize)
+            {
+                uint32 amount = std::min(_publicKeySize-_asymRemote0ReceivedSize, data.size());
+                data.removeTo(&_asymRemote[_asymRemote0ReceivedSize], amount);
+                _asymRemote0ReceivedSize += amount;
 
-        if(_asymRemote0ReceivedSize < _publicKeySize)
+                if(_publicKeySize == _asymRemote0ReceivedSize && (_asymRemote[_publicKeySize-1] & _resumptionFlag))
+                {
+                    _asymRemote[_publicKeySize-1] &= uint8(~_resumptionFlag);
+                    _remoteTicketPresented = true;
+
+                    if(_authRemoteKnown)
+                    {
+                        //при известном ключе удаленной стороны полезная нагрузка идет сразу, вердикт некуда вставить
+                        _protocol->handshakeFail("unexpected resumption ticket");
+                        return;
+                    }
+                }
+            }
+            else
+            {
+                uint32 offset = _asymRemote0ReceivedSize - _publicKeySize;
+                uint32 amount = std::min(remoteKey0Size()-_asymRemote0ReceivedSize, data.size());
+                data.removeTo(&_remote0Tail[offset], amount);
+                _asymRemote0ReceivedSize += amount;
+            }
+
+            if(_remoteTicketPresented && !_remoteTicketAnswered &&
+               _asymRemote0ReceivedSize >= _publicKeySize + TicketCache::_idSize)
+            {
+                //вердикт сразу, не дожидаясь вердикта по своему билету - иначе обе стороны ждали бы друг друга
+                answerRemoteTicket();
+            }
+        }
+
+        if(_asymRemote0ReceivedSize < remoteKey0Size())
         {
             return;
         }
 
+        if(_ticketPresented && !_authRemoteKnown)
+        {
+            _ticketAccepted = 1 == _remote0Tail[_remoteTicketPresented ? TicketCache::_idSize : 0];
+        }
+
         _asymRemoteAge++;
         dbgAssert(_asymLocalAge);
 
+        if(_authRemoteKnown)
+        {
+            //выходное направление уже на статических ключах, входное - так же; статический ключ
+            //удаленной стороны подтвердится первым расшифрованным кадром
+            updateInputKeyKnown();
+            _remoteAuthentificationInitiated = true;
+
+            //следующий эфемерный смешает ee для прямой секретности
+            growLocalKey();
+            return;
+        }
+
         if(1 == _asymLocal.size())
         {
             updateBothKeys();
@@ -307,12 +702,129 @@ namespace dci::module::stiac::crypto
             updateOutputKey();
         }
 
+        if(_ticketAccepted || _remoteTicketAccepted)
+        {
+            resume();
+            return;
+        }
+
         if(!_authLocal.empty())
         {
             growLocalKey();
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Handshake::remoteKey0Size() const
+    {
+        uint32 res = _publicKeySize;
+
+        if(_remoteTicketPresented)
+        {
+            res += TicketCache::_idSize;
+        }
+
+        if(_ticketPresented && !_authRemoteKnown)
+        {
+            res += 1;
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::answerRemoteTicket()
+    {
+        _remoteTicketAnswered = true;
+
+        TicketCache::Id id;
+        std::memcpy(id.data(), _remote0Tail.data(), id.size());
+
+        //билет одноразовый и привязан к своему статическому ключу
+        _remoteTicketAccepted =
+                TicketCache::instance().take(id, _remoteTicket) &&
+                _remoteTicket._local == _authLocalPublic;
+
+        //сырым, до первого шифрованного кадра
+        uint8 verdict = _remoteTicketAccepted ? 1 : 0;
+        _outCiphering->urgent(MessageType::fakeNull, &verdict, sizeof(verdict));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::resume()
+    {
+        _resumed = true;
+
+        //секреты принятых билетов поверх ee, первым - билет стороны с меньшим эфемерным ключом
+        bool ownFirst = _asymLocal.front()._public < _asymRemote;
+        for(bool own : {ownFirst, !ownFirst})
+        {
+            if(own ? _ticketAccepted : _remoteTicketAccepted)
+            {
+                const uint8* secret = own ? _ticketSecret.data() : _remoteTicket._secret.data();
+                _inCiphering->mixKey(secret);
+                _outCiphering->mixKey(secret);
+            }
+        }
+
+        //билет подтверждает обе стороны, статические ключи не нужны. Удаленная сторона
+        //считается аутентифицированной после первого расшифрованного кадра
+        if(_remoteTicketAccepted)
+        {
+            std::memcpy(_authRemote.data(), _remoteTicket._remote.data(), _authRemote.size());
+        }
+        else
+        {
+            _authRemote = _ticketRemote;
+        }
+
+        if(!isZeros(_authRemote.data(), static_cast<uint32>(_authRemote.size())))
+        {
+            _remoteAuthentificationInitiated = true;
+        }
+
+        const auto& pm = _protocol->protocolMarker();
+        _outCiphering->urgent(MessageType::protocolMarker, pm.data(), static_cast<uint32>(pm.size()));
+        _protocolMarkerSent = true;
+
+        _outCiphering->allowPayload();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::issueTicket()
+    {
+        if(!_resumptionLifetime)
+        {
+            return;
+        }
+
+        TicketCache::Id id;
+        if(!KeyPool::random(id.data(), id.size()))
+        {
+            //без билета, следующее подключение пройдет полное рукопожатие
+            return;
+        }
+
+        std::array<uint8, _ticketMessageSize> msg;
+        std::memcpy(msg.data(), id.data(), id.size());
+        uint32 lifetime = stiac::serialization::fixEndian(_resumptionLifetime);
+        std::memcpy(msg.data() + id.size(), &lifetime, sizeof(lifetime));
+
+        _outCiphering->urgent(MessageType::ticket, msg.data(), static_cast<uint32>(msg.size()));
+
+        TicketCache::Entry entry;
+        entry._local = _authLocalPublic;
+        std::memcpy(entry._remote.data(), _authRemote.data(), entry._remote.size());
+        entry._expire = std::chrono::steady_clock::now() + std::chrono::seconds(_resumptionLifetime);
+
+        //секрет сразу после кадра с билетом, как его выведет получатель
+        _outCiphering->exportSecret([id, entry=std::move(entry)](const uint8* secret) mutable
+        {
+            std::memcpy(entry._secret.data(), secret, entry._secret.size());
+            TicketCache::instance().put(id, entry);
+        });
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Handshake::growRemoteKey(bytes::Alter& data, bool isStatic)
     {
@@ -321,6 +833,12 @@ namespace dci::module::stiac::crypto
 
         data.removeTo(_asymRemote.data(), _asymRemote.size());
 
+        //сменой считается только эфемерный ключ, пришедший на замену уже бывшему
+        if(!isStatic && _asymRemoteAge > 1)
+        {
+            _remoteRekeys++;
+        }
+
         _asymRemoteAge++;
         dbgAssert(_asymLocalAge);
 
@@ -363,8 +881,10 @@ namespace dci::module::stiac::crypto
 
         updateKey(_asymLocal.back(), _outCiphering);
 
+        _ratchetsSinceDh = 0;
         _outputTrafficCounter = 0;
         _outputTrafficSize = 0;
+        _outputKeyMoment = std::chrono::steady_clock::now();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -383,8 +903,65 @@ namespace dci::module::stiac::crypto
             target->mixHash(asymLocal._public.data(), asymLocal._public.size());
         }
 
+        mixDh(target, _asymRemote.data(), asymLocal._private.data());
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::updateInputKeyKnown()
+    {
+        //направление удаленная->локальная: e удаленной, s удаленной, s локальной; es и ss
+        _inCiphering->mixHash(_asymRemote.data(), _asymRemote.size());
+        _inCiphering->mixHash(_authRemote.data(), static_cast<uint32>(_authRemote.size()));
+        _inCiphering->mixHash(_authLocalPublic.data(), _authLocalPublic.size());
+
+        mixDh(_inCiphering, _asymRemote.data(), _authLocal.data());
+        mixDh(_inCiphering, _authRemote.data(), _authLocal.data());
+
+        _inputTrafficCounter = 0;
+        _inputTrafficSize = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::updateOutputKeyKnown()
+    {
+        dbgAssert(1 == _asymLocal.size());
+        const KeyPair& asymLocal = _asymLocal.back();
+
+        //зеркально updateInputKeyKnown удаленной стороны
+        _outCiphering->mixHash(asymLocal._public.data(), asymLocal._public.size());
+        _outCiphering->mixHash(_authLocalPublic.data(), _authLocalPublic.size());
+        _outCiphering->mixHash(_authRemote.data(), static_cast<uint32>(_authRemote.size()));
+
+        mixDh(_outCiphering, _authRemote.data(), asymLocal._private.data());
+        mixDh(_outCiphering, _authRemote.data(), _authLocal.data());
+
+        _ratchetsSinceDh = 0;
+        _outputTrafficCounter = 0;
+        _outputTrafficSize = 0;
+        _outputKeyMoment = std::chrono::steady_clock::now();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::mixDh(Symmetric* target, const uint8* remotePublic, const uint8* localPrivate)
+    {
+        if(_offload)
+        {
+            target->mixKeyLater();
+            _dhPool->submit(this, remotePublic, localPrivate, [this, target](const uint8* sym)
+            {
+                if(!sym)
+                {
+                    _protocol->handshakeFail("bad remote public key detected");
+                    return;
+                }
+
+                target->mixKeyArrived(sym);
+            });
+            return;
+        }
+
         uint8 sym[_symmetricKeySize];
-        dci::crypto::curve25519::donna(_asymRemote.data(), asymLocal._private.data(), sym);
+        dci::crypto::curve25519::donna(remotePublic, localPrivate, sym);
 
         if(isZeros(sym, sizeof(sym)))
         {
@@ -420,24 +997,86 @@ namespace dci::module::stiac::crypto
                 _inCiphering->mixHash(asymLocal._public.data(), asymLocal._public.size());
             }
 
-            uint8 sym[_symmetricKeySize];
-            dci::crypto::curve25519::donna(_asymRemote.data(), asymLocal._private.data(), sym);
-
-            if(isZeros(sym, sizeof(sym)))
+            if(_offload)
             {
-                _protocol->handshakeFail("bad remote public key detected");
-                return;
+                _outCiphering->mixKeyLater();
+                _inCiphering->mixKeyLater();
+                _dhPool->submit(this, _asymRemote.data(), asymLocal._private.data(), [this](const uint8* sym)
+                {
+                    if(!sym)
+                    {
+                        _protocol->handshakeFail("bad remote public key detected");
+                        return;
+                    }
+
+                    _outCiphering->mixKeyArrived(sym);
+                    _inCiphering->mixKeyArrived(sym);
+                });
             }
+            else
+            {
+                uint8 sym[_symmetricKeySize];
+                dci::crypto::curve25519::donna(_asymRemote.data(), asymLocal._private.data(), sym);
+
+                if(isZeros(sym, sizeof(sym)))
+                {
+                    _protocol->handshakeFail("bad remote public key detected");
+                    return;
+                }
 
-            _outCiphering->mixKey(sym);
-            _inCiphering->mixKey(sym);
+                _outCiphering->mixKey(sym);
+                _inCiphering->mixKey(sym);
+            }
         }
 
+        _ratchetsSinceDh = 0;
         _outputTrafficCounter = 0;
         _outputTrafficSize = 0;
+        _outputKeyMoment = std::chrono::steady_clock::now();
 
         _inputTrafficCounter = 0;
         _inputTrafficSize = 0;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Handshake::RekeyPolicy Handshake::defaultRekeyPolicy(Aead::Kind kind)
+    {
+        using namespace std::chrono_literals;
+
+        switch(kind)
+        {
+        case Aead::Kind::aes256gcm:
+            //у GCM запас по объему на одном ключе меньше
+            return RekeyPolicy{uint32(1) << 20, uint64(1) << 32, 10min};
+
+        case Aead::Kind::chacha20poly1305:
+        case Aead::Kind::chacha20poly1305ietf:
+        case Aead::Kind::poly1305:
+            break;
+        }
+
+        return RekeyPolicy{uint32(1) << 20, uint64(1) << 36, 10min};
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Handshake::applyRekeyPolicy()
+    {
+        _rekeyPolicy = defaultRekeyPolicy(_outputAead);
+
+        if(_paramRekeyMessages)
+        {
+            _rekeyPolicy._messages = _paramRekeyMessages;
+        }
+
+        if(_paramRekeyBytes)
+        {
+            _rekeyPolicy._bytes = _paramRekeyBytes;
+        }
+
+        if(_paramRekeySeconds)
+        {
+            _rekeyPolicy._interval = std::chrono::seconds{_paramRekeySeconds};
+        }
+    }
+
 }
@@ -9,6 +9,10 @@
 
 #include "pch.hpp"
 #include "secret.hpp"
+#include "aead.hpp"
+#include "keyPool.hpp"
+#include "dhPool.hpp"
+#include "ticketCache.hpp"
 
 namespace dci::module::stiac
 {
@@ -37,6 +41,13 @@ namespace dci::module::stiac::crypto
         static constexpr uint32 _privateKeySize = 32;
         static constexpr uint32 _symmetricKeySize = 32;
 
+        //тело кадра: классический заголовок 16 бит, длинный - 32 бита по согласованию через маркер
+        static constexpr uint32 _shortFrameSize = 0x10000 - 16 - 1 - 2;
+        static constexpr uint32 _longFrameSizeLimit = 1024*1024*4;
+
+        //номер билета и срок его действия в секундах
+        static constexpr uint32 _ticketMessageSize = TicketCache::_idSize + 4;
+
         enum class MessageType : uint8
         {
             payloadChunk        = 0,
@@ -47,6 +58,15 @@ namespace dci::module::stiac::crypto
             skey                = 4,
             keyApplied          = 5,
 
+            aead                = 6,
+
+            payloadLongChunk     = 7,
+            payloadLongLastChunk = 8,
+
+            ratchet             = 9,
+
+            ticket              = 10,
+
             maxValue            = 15,
             fakeNull            = 16,
         };
@@ -60,9 +80,46 @@ namespace dci::module::stiac::crypto
         ~Handshake();
 
     public:
-        void setAuth(const Bytes& prologue, const apip::PrivateKey& local);
+        //remote - заранее известный статический ключ удаленной стороны (нулевой - неизвестен). При известном
+        //ключе каждая сторона выводит ключ своего направления сразу (как Noise KK) и отправляет полезную
+        //нагрузку первым же пакетом вслед за эфемерным ключом
+        void setAuth(const Bytes& prologue, const apip::PrivateKey& local, const apip::PublicKey& remote);
+
+        //полезная нагрузка в первом пакете при известном ключе удаленной стороны. Такой пакет повторяем,
+        //при false (по умолчанию) нагрузка ждет эфемерного ключа удаленной стороны, а пришедшая раньше
+        //придерживается входом до первого кадра на ключе с ним
+        void setEarlyPayload(bool enable);
+        bool inputPayloadAllowed() const;
+
+        //маска 1<<Aead::Kind, допустимые локально алгоритмы и принимаемые удаленной стороной
+        void setAeads(uint8 local);
+        uint8 aeads() const;
+        void remoteAeads(uint8 remote);
         apip::PublicKey remoteAuth();
 
+        //пороги смены собственного ключа по числу кадров, объему и времени; 0 - значение по умолчанию для текущего алгоритма
+        void setRekeyPolicy(uint32 messages, uint64 bytes, uint32 seconds);
+        //DH в пуле рабочих потоков, смена ключа завершается позже на этом потоке
+        void setOffload(bool enable);
+        //эфемерные пары из запаса KeyPool, иначе на месте
+        void setKeyPool(bool enable);
+
+        uint64 rekeys() const;
+        uint64 remoteRekeys() const;
+
+        //между сменами ключа через DH до perDh смен храповиком, если удаленная сторона тоже его включила
+        void setRatchet(uint32 perDh);
+        uint32 ratchet() const;
+        void remoteRatchet(bool enabled);
+        uint64 ratchets() const;
+        uint64 remoteRatchets() const;
+
+        //выдавать аутентифицированной удаленной стороне билеты возобновления на lifetime секунд, 0 - не выдавать
+        void setResumption(uint32 lifetime);
+        //предъявить билет при рукопожатии; если удаленная сторона его не примет - обычное рукопожатие
+        void setResumptionTicket(const apip::ResumptionTicket& ticket);
+        bool resumed() const;
+
         void start();
 
     public:
@@ -73,23 +130,42 @@ namespace dci::module::stiac::crypto
         void inputComing(MessageType messageType, bytes::Alter& data);
 
         void outputTraffic(uint32 size);
-        void inputTraffic(uint32 size);
+        void inputTraffic(uint64 size);
+
+        //номера кадров внешнему шифровальщику в счет порогов смены ключа: не больше оставшегося до порога,
+        //при исчерпанном - сначала смена ключа. Объем выделенного считается по maxFrameSize на кадр
+        uint32 outputLeaseLimit(uint32 frames, uint32 maxFrameSize);
+        void outputLeased(uint32 frames, uint32 maxFrameSize);
 
     private:
         void growLocalKey();
+        void ratchetLocalKey();
+        void rekeyLocalKey();
         void cropLocalKey();
         void growRemoteKey0(bytes::Alter& data);
         void growRemoteKey(bytes::Alter& data, bool isStatic);
 
+        uint32 remoteKey0Size() const;
+        void answerRemoteTicket();
+        void resume();
+        void issueTicket();
+
     private:
         using PublicKey = Secret<_publicKeySize>;
-        using PrivateKey = Secret<_privateKeySize>;
-        struct KeyPair
+        using KeyPair = KeyPool::KeyPair;
+        static_assert(KeyPool::_keySize == _publicKeySize && KeyPool::_keySize == _privateKeySize);
+
+    private:
+        struct RekeyPolicy
         {
-            PublicKey   _public;
-            PrivateKey  _private;
+            uint32                              _messages;
+            uint64                              _bytes;
+            std::chrono::steady_clock::duration _interval;
         };
 
+        static RekeyPolicy defaultRekeyPolicy(Aead::Kind kind);
+        void applyRekeyPolicy();
+
     private:
         void updateInputKey();
         void updateOutputKey();
@@ -97,9 +173,16 @@ namespace dci::module::stiac::crypto
 
         void updateBothKeys();
 
+        void updateInputKeyKnown();
+        void updateOutputKeyKnown();
+        void mixDh(Symmetric* target, const uint8* remotePublic, const uint8* localPrivate);
+
     private:
         apip::PrivateKey    _authLocal;
         apip::PublicKey     _authRemote;
+        bool                _authRemoteKnown = false;
+        bool                _earlyPayload = false;
+        PublicKey           _authLocalPublic;
         bool                _remoteAuthentificationInitiated = false;
         bool                _remoteAuthentificated = false;
 
@@ -113,6 +196,50 @@ namespace dci::module::stiac::crypto
 
         bool                _protocolMarkerSent = false;
 
+        uint8               _localAeads = uint8(1) << static_cast<uint8>(Aead::Kind::chacha20poly1305);
+        bool                _aeadNegotiated = false;
+        Aead::Kind          _outputAead = Aead::Kind::chacha20poly1305;
+
+    private:
+        uint32              _paramRekeyMessages = 0;
+        uint64              _paramRekeyBytes = 0;
+        uint32              _paramRekeySeconds = 0;
+        RekeyPolicy         _rekeyPolicy = defaultRekeyPolicy(Aead::Kind::chacha20poly1305);
+
+        uint64              _rekeys = 0;
+        uint64              _remoteRekeys = 0;
+
+        bool                _offload = false;
+        bool                _keyPool = false;
+        DhPoolPtr           _dhPool;
+
+        uint32              _ratchetPerDh = 0;
+        bool                _remoteRatchet = false;
+        uint32              _ratchetsSinceDh = 0;
+        uint64              _ratchets = 0;
+        uint64              _remoteRatchets = 0;
+
+    private:
+        //флаг в старшем бите последнего байта сырого ключа (curve25519 его не использует): следом номер билета
+        static constexpr uint8 _resumptionFlag = 0x80;
+
+        uint32              _resumptionLifetime = 0;
+
+        bool                _ticketPresented = false;
+        TicketCache::Id     _ticketId {};
+        Secret<TicketCache::_secretSize> _ticketSecret;
+        apip::PublicKey     _ticketRemote {};
+        bool                _ticketAccepted = false;
+
+        //хвост сырых данных удаленной стороны: номер ее билета, вердикт по своему
+        std::array<uint8, TicketCache::_idSize + 1> _remote0Tail {};
+        bool                _remoteTicketPresented = false;
+        bool                _remoteTicketAnswered = false;
+        bool                _remoteTicketAccepted = false;
+        TicketCache::Entry  _remoteTicket;
+
+        bool                _resumed = false;
+
     private:
         Protocol *                  _protocol = nullptr;
         stages::in::Ciphering *     _inCiphering = nullptr;
@@ -124,6 +251,7 @@ namespace dci::module::stiac::crypto
 
         uint64  _outputTrafficCounter = 0;
         uint64  _outputTrafficSize = 0;
+        std::chrono::steady_clock::time_point _outputKeyMoment = std::chrono::steady_clock::now();
     };
 
     using HandshakePtr = std::unique_ptr<Handshake>;
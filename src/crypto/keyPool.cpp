@@ -0,0 +1,183 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "keyPool.hpp"
+#include <pthread.h>
+
+namespace dci::module::stiac::crypto
+{
+    namespace
+    {
+        std::mutex rndMtx;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    KeyPool& KeyPool::instance()
+    {
+        static KeyPool instance;
+        return instance;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool KeyPool::take(KeyPair& kp)
+    {
+        std::unique_lock lock(_mtx);
+
+        if(_restart)
+        {
+            //поток родителя в дочернем процессе не существует, его объект только отпустить
+            _restart = false;
+            _generateFailed = false;
+            _thread.detach();
+            _thread = std::thread([this]{work();});
+        }
+
+        if(_ready.size() <= _lowWater)
+        {
+            //после отказа генератора новая попытка только по запросу потребителя
+            _generateFailed = false;
+            _cv.notify_one();
+        }
+
+        if(_ready.empty())
+        {
+            return false;
+        }
+
+        kp = _ready.front();
+        _ready.pop_front();
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool KeyPool::generate(KeyPair& kp)
+    {
+        for(;;)
+        {
+            if(!random(kp._private.data(), kp._private.size()))
+            {
+                return false;
+            }
+
+            dci::crypto::curve25519::basepoint(kp._private.data(), kp._public.data());
+
+            uint8 sum = 0;
+            for(uint8 v : kp._public)
+            {
+                sum |= v;
+            }
+
+            if(sum)
+            {
+                return true;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool KeyPool::random(void* data, std::size_t size)
+    {
+        std::lock_guard lock(rndMtx);
+        return dci::crypto::rnd::generate(data, size);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    KeyPool::KeyPool()
+        : _thread([this]{work();})
+    {
+        pthread_atfork(
+            []{instance().forkPrepare();},
+            []{instance().forkParent();},
+            []{instance().forkChild();});
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    KeyPool::~KeyPool()
+    {
+        {
+            std::unique_lock lock(_mtx);
+            _stop = true;
+        }
+        _cv.notify_one();
+
+        if(_restart)
+        {
+            _thread.detach();
+        }
+        else
+        {
+            _thread.join();
+        }
+
+        _ready.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void KeyPool::work()
+    {
+        std::unique_lock lock(_mtx);
+
+        for(;;)
+        {
+            _cv.wait(lock, [this]{return _stop || (!_generateFailed && _ready.size() <= _lowWater);});
+            if(_stop)
+            {
+                return;
+            }
+
+            //до полного, вычисление вне блокировки
+            while(!_stop && _ready.size() < _capacity)
+            {
+                lock.unlock();
+
+                KeyPair kp;
+                bool ok = generate(kp);
+
+                lock.lock();
+
+                if(!ok)
+                {
+                    //генератор отказал, остальное пусть делают потребители на месте, до следующего take не крутиться
+                    _generateFailed = true;
+                    break;
+                }
+
+                _ready.push_back(kp);
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void KeyPool::forkPrepare()
+    {
+        //ни запас, ни генератор не должны быть посреди работы на время fork
+        rndMtx.lock();
+        _mtx.lock();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void KeyPool::forkParent()
+    {
+        _mtx.unlock();
+        rndMtx.unlock();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void KeyPool::forkChild()
+    {
+        //ожидавший поток остался в родителе, его след в условной переменной не нужен
+        new (&_cv) std::condition_variable;
+
+        //пары затираются при удалении
+        _ready.clear();
+
+        _restart = true;
+        _mtx.unlock();
+        rndMtx.unlock();
+    }
+}
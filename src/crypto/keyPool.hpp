@@ -0,0 +1,70 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "pch.hpp"
+#include "secret.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /* Запас готовых эфемерных пар curve25519.
+     *
+     * Один на процесс, пополняется фоновым потоком: генерация случайного закрытого ключа
+     * и basepoint уходят с пути данных, рукопожатия и смены ключа берут готовую пару.
+     * Если запас исчерпан - пара вычисляется на месте, как раньше.
+     *
+     * После fork в дочернем процессе запас выбрасывается (те же пары остались у родителя),
+     * фоновый поток перезапускается при первом take.
+     */
+    class KeyPool
+    {
+    public:
+        static constexpr uint32 _keySize = 32;
+
+        struct KeyPair
+        {
+            Secret<_keySize>    _public;
+            Secret<_keySize>    _private;
+        };
+
+    public:
+        static KeyPool& instance();
+
+        //неблокирующее, false если запас пуст
+        bool take(KeyPair& kp);
+
+        //синхронно, false при отказе генератора случайных чисел
+        static bool generate(KeyPair& kp);
+
+        //dci::crypto::rnd::generate не обещает потокобезопасности, все вызовы модуля идут через эту блокировку
+        static bool random(void* data, std::size_t size);
+
+    private:
+        KeyPool();
+        ~KeyPool();
+
+        void work();
+
+        void forkPrepare();
+        void forkParent();
+        void forkChild();
+
+    private:
+        static constexpr std::size_t _capacity = 64;
+        static constexpr std::size_t _lowWater = 16;
+
+        std::mutex              _mtx;
+        std::condition_variable _cv;
+        std::deque<KeyPair>     _ready;
+        bool                    _stop = false;
+        bool                    _generateFailed = false;
+        bool                    _restart = false;//дочерний после fork, потока нет
+        std::thread             _thread;
+    };
+}
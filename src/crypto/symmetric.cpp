@@ -18,10 +18,14 @@ namespace dci::module::stiac::crypto
         cleanMemoryUnder(_keySetted);
 
         _aead.clear();
+        cleanMemoryUnder(_pendingAead);
+        cleanMemoryUnder(_hasPendingAead);
         _hashMixer.clear();
         _mac4kdf.clear();
 
         cleanMemoryUnder(_nonce);
+
+        _deferred.clear();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -35,14 +39,20 @@ namespace dci::module::stiac::crypto
     {
         _keySetted = false;
         _aead.clear();
+        _aead.setKind(Aead::Kind::chacha20poly1305);
+        _hasPendingAead = false;
         _hash.fill(0);
         _chainingKey.fill(0);
+        _key.fill(0);
         _nonce._counter = 0;
+        _deferred.clear();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::mixHash(const Bytes& material)
     {
+        dbgAssert(!keyDeferred());
+
         _hashMixer.add(_hash.data(), _hash.size());
 
         bytes::Cursor c(material.begin());
@@ -63,6 +73,22 @@ namespace dci::module::stiac::crypto
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::mixHash(const void* materialData, uint32 materialSize)
+    {
+        if(keyDeferred())
+        {
+            const uint8* begin = static_cast<const uint8*>(materialData);
+            defer([this, material = std::vector<uint8>(begin, begin + materialSize)]
+            {
+                mixHashNow(material.data(), static_cast<uint32>(material.size()));
+            });
+            return;
+        }
+
+        mixHashNow(materialData, materialSize);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::mixHashNow(const void* materialData, uint32 materialSize)
     {
         _hashMixer.add(_hash.data(), _hash.size());
         _hashMixer.add(materialData, materialSize);
@@ -71,6 +97,23 @@ namespace dci::module::stiac::crypto
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::mixKey(const uint8 material[_keySize])
+    {
+        if(keyDeferred())
+        {
+            Secret<_keySize> copy;
+            std::memcpy(copy.data(), material, _keySize);
+            defer([this, copy]
+            {
+                mixKeyNow(copy.data());
+            });
+            return;
+        }
+
+        mixKeyNow(material);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::mixKeyNow(const uint8 material[_keySize])
     {
         _mac4kdf.setKey(_chainingKey.data(), _chainingKey.size());
         //_mac4kdf.start();
@@ -92,10 +135,180 @@ namespace dci::module::stiac::crypto
         _mac4kdf.add(two, sizeof(two));
         _mac4kdf.finish(_chainingKey.data());
 
-        _aead.setKey(key, _keySize);
-        _nonce._counter = 0;
+        applyKey(key);
+    }
 
-        _keySetted = true;
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::ratchet()
+    {
+        if(keyDeferred())
+        {
+            defer([this]{ratchetNow();});
+            return;
+        }
+
+        ratchetNow();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::exportSecret(std::function<void(const uint8* secret)>&& done)
+    {
+        if(keyDeferred())
+        {
+            defer([this, done=std::move(done)]{exportSecretNow(done);});
+            return;
+        }
+
+        exportSecretNow(done);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::ratchetNow()
+    {
+        dbgAssert(_keySetted);
+
+        //ключ и новый цепной ключ выводятся из текущего цепного, старый затирается - раскрытие
+        //текущего состояния не раскрывает прошлые ключи
+        _mac4kdf.setKey(_chainingKey.data(), _chainingKey.size());
+        const uint8 three[1] = {3};
+        _mac4kdf.add(three, sizeof(three));
+        uint8 key[_hashSize];
+        _mac4kdf.finish(key);
+
+        _mac4kdf.setKey(_chainingKey.data(), _chainingKey.size());
+        _mac4kdf.add(key, sizeof(key));
+        const uint8 four[1] = {4};
+        _mac4kdf.add(four, sizeof(four));
+        _mac4kdf.finish(_chainingKey.data());
+
+        applyKey(key);
+        cleanMemoryUnder(key);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::exportSecretNow(const std::function<void(const uint8* secret)>& done)
+    {
+        dbgAssert(_keySetted);
+
+        //односторонне от цепного, по секрету нельзя восстановить ключи соединения
+        _mac4kdf.setKey(_chainingKey.data(), _chainingKey.size());
+        const uint8 five[1] = {5};
+        _mac4kdf.add(five, sizeof(five));
+        uint8 secret[_hashSize];
+        _mac4kdf.finish(secret);
+
+        done(secret);
+        cleanMemoryUnder(secret);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::setPendingAead(Aead::Kind kind)
+    {
+        if(keyDeferred())
+        {
+            defer([this, kind]
+            {
+                _pendingAead = kind;
+                _hasPendingAead = true;
+            });
+            return;
+        }
+
+        _pendingAead = kind;
+        _hasPendingAead = true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::mixKeyLater()
+    {
+        _deferred.emplace_back();
+        _deferred.back()._hole = true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::mixKeyArrived(const uint8 material[_keySize])
+    {
+        for(Deferred& d : _deferred)
+        {
+            if(d._hole && !d._filled)
+            {
+                std::memcpy(d._material.data(), material, _keySize);
+                d._filled = true;
+                drainDeferred();
+                return;
+            }
+        }
+
+        dbgWarn("key arrived without request");
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Symmetric::keyDeferred() const
+    {
+        return !_deferred.empty();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::defer(std::function<void()>&& op)
+    {
+        dbgAssert(keyDeferred());
+        _deferred.emplace_back();
+        _deferred.back()._op = std::move(op);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::keySettled()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::keyChanged()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Symmetric::leaseNonces(uint32 amount, Aead::Kind& kind, uint8 key[_keySize], uint64& nonce, uint8 ad[_hashSize])
+    {
+        if(!_keySetted || keyDeferred())
+        {
+            return false;
+        }
+
+        kind = _aead.kind();
+        std::memcpy(key, _key.data(), _keySize);
+        nonce = _nonce._counter;
+        std::memcpy(ad, _hash.data(), _hashSize);
+
+        _nonce._counter += amount;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::drainDeferred()
+    {
+        while(!_deferred.empty())
+        {
+            if(_deferred.front()._hole && !_deferred.front()._filled)
+            {
+                //ждать следующий ключ
+                return;
+            }
+
+            //исполняется в обход откладывания, вложенные вызовы встают за оставшимся
+            Deferred d = std::move(_deferred.front());
+            _deferred.pop_front();
+
+            if(d._hole)
+            {
+                mixKeyNow(d._material.data());
+            }
+            else
+            {
+                d._op();
+            }
+        }
+
+        keySettled();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -107,6 +320,30 @@ namespace dci::module::stiac::crypto
 
         _aead.setAd(_hash.data(), _hash.size());
         _aead.start(nonce._raw, sizeof(nonce));
+        _messageOffset = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Symmetric::messageStartDetached(uint32 key[8], uint8 nonce[12], uint8 ad[_hashSize])
+    {
+        const ChaChaPoly* chachaPoly = _aead.chachaPoly();
+        if(!chachaPoly)
+        {
+            return false;
+        }
+
+        Nonce n = _nonce;
+        _nonce._counter++;
+        n._counter = stiac::serialization::fixEndian(n._counter);
+
+        //как в start: 8 байт дополняются слева нулями
+        std::memset(nonce, 0, 12 - sizeof(n));
+        std::memcpy(nonce + 12 - sizeof(n), n._raw, sizeof(n));
+
+        std::memcpy(key, chachaPoly->keyWords(), sizeof(uint32)*8);
+        std::memcpy(ad, _hash.data(), _hash.size());
+
+        return true;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -118,12 +355,14 @@ namespace dci::module::stiac::crypto
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::messageEncipher(void* data, uint32 size)
     {
+        _messageOffset += size;
         _aead.encipher(data, data, size);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::messageDecipher(void* data, uint32 size)
     {
+        _messageOffset += size;
         _aead.decipher(data, data, size);
     }
 
@@ -133,6 +372,18 @@ namespace dci::module::stiac::crypto
         _hashMixer.add(data, size);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::messageEncipher(Bytes& data, bool mix2Hash)
+    {
+        processSegments(data, mix2Hash, true);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::messageDecipher(Bytes& data, bool mix2Hash)
+    {
+        processSegments(data, mix2Hash, false);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Symmetric::messageEncipherFinish(void* macOut)
     {
@@ -150,4 +401,130 @@ namespace dci::module::stiac::crypto
     {
         _hashMixer.finish(_hash.data());
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::applyKey(const uint8 key[_keySize])
+    {
+        if(_hasPendingAead)
+        {
+            _aead.setKind(_pendingAead);
+            _hasPendingAead = false;
+        }
+
+        _aead.setKey(key, _keySize);
+        std::memcpy(_key.data(), key, _keySize);
+        _nonce._counter = 0;
+
+        _keySetted = true;
+
+        keyChanged();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::processSegments(Bytes& data, bool mix2Hash, bool encipher)
+    {
+        struct Segment
+        {
+            uint8*  _data;
+            uint32  _size;
+        };
+
+        std::array<Segment, _stagingMaxSegments> segments;
+        uint32 segmentsAmount = 0;
+        uint32 stagingSize = 0;
+
+        auto stage = [&](uint8* segmentData, uint32 segmentSize)
+        {
+            std::memcpy(_staging + stagingSize, segmentData, segmentSize);
+            segments[segmentsAmount++] = Segment{segmentData, segmentSize};
+            stagingSize += segmentSize;
+        };
+
+        auto flushStaging = [&]
+        {
+            if(!stagingSize)
+            {
+                return;
+            }
+
+            processRun(_staging, stagingSize, mix2Hash, encipher);
+
+            const uint8* src = _staging;
+            for(uint32 i(0); i<segmentsAmount; ++i)
+            {
+                std::memcpy(segments[i]._data, src, segments[i]._size);
+                src += segments[i]._size;
+            }
+
+            cleanMemoryUnder(_staging, stagingSize);
+            segmentsAmount = 0;
+            stagingSize = 0;
+        };
+
+        bytes::Alter alter(data.begin());
+        while(!alter.atEnd())
+        {
+            uint8* segmentData = static_cast<uint8*>(alter.continuousData4Write());
+            uint32 segmentSize = alter.continuousDataSize();
+
+            if(segmentSize < _smallSegmentSize)
+            {
+                if(stagingSize + segmentSize > _stagingSize || segmentsAmount == _stagingMaxSegments)
+                {
+                    flushStaging();
+                }
+
+                stage(segmentData, segmentSize);
+            }
+            else
+            {
+                //голову крупного сегмента доложить в сборку, чтобы крупный прогон начинался с границы блока
+                if(stagingSize + _runAlignment > _stagingSize || segmentsAmount == _stagingMaxSegments)
+                {
+                    flushStaging();
+                }
+
+                uint32 head = static_cast<uint32>((_runAlignment - (_messageOffset + stagingSize) % _runAlignment) % _runAlignment);
+                if(head)
+                {
+                    stage(segmentData, head);
+                    segmentData += head;
+                    segmentSize -= head;
+                }
+
+                flushStaging();
+
+                processRun(segmentData, segmentSize, mix2Hash, encipher);
+            }
+
+            alter.advanceChunks(1);
+        }
+
+        flushStaging();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Symmetric::processRun(uint8* data, uint32 size, bool mix2Hash, bool encipher)
+    {
+        _messageOffset += size;
+
+        if(encipher)
+        {
+            _aead.encipher(data, data, size);
+
+            if(mix2Hash)
+            {
+                mixHashUpdate(data, size);
+            }
+        }
+        else
+        {
+            if(mix2Hash)
+            {
+                mixHashUpdate(data, size);
+            }
+
+            _aead.decipher(data, data, size);
+        }
+    }
 }
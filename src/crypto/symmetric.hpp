@@ -10,6 +10,7 @@
 #include "pch.hpp"
 #include "handshake.hpp"
 #include "secret.hpp"
+#include "aead.hpp"
 
 namespace dci::module::stiac::crypto
 {
@@ -21,13 +22,18 @@ namespace dci::module::stiac::crypto
         static constexpr uint16 _nonceSize          = 8;
         static constexpr uint16 _genericHeaderSize  = 1;
         static constexpr uint16 _payloadHeaderSize  = 2;
+        static constexpr uint16 _longPayloadHeaderSize = 4;
         static constexpr uint16 _macSize            = 16;
 
+        static constexpr uint32 _shortFrameSize     = Handshake::_shortFrameSize;
+        static constexpr uint32 _longFrameSizeLimit = Handshake::_longFrameSizeLimit;
+        static_assert(0x10000 == _shortFrameSize + _genericHeaderSize + _payloadHeaderSize + _macSize);
+
     protected:
         using MessageType = Handshake::MessageType;
 
     public:
-        ~Symmetric();
+        virtual ~Symmetric();
 
         void setHandshake(Handshake* hs);
 
@@ -39,25 +45,76 @@ namespace dci::module::stiac::crypto
 
         void mixKey(const uint8 material[_keySize]);
 
+        //следующий ключ только из цепного, без DH и без обмена с удаленной стороной
+        void ratchet();
+
+        //секрет для билета возобновления из текущего цепного ключа, состояние не меняется. Обе стороны
+        //получают одно и то же, если вызывают в одной точке потока кадров
+        void exportSecret(std::function<void(const uint8* secret)>&& done);
+
+        //материал для mixKey придет позже (DH в пуле потоков). До его прихода операции с состоянием
+        //копятся и исполняются по порядку, ключи приходят в порядке mixKeyLater
+        void mixKeyLater();
+        void mixKeyArrived(const uint8 material[_keySize]);
+        bool keyDeferred() const;
+
+        //алгоритм сменится при следующем mixKey
+        void setPendingAead(Aead::Kind kind);
+
     protected:
         void messageStart();
         void mixHashStart();
 
+        //снимок ключа, нонса и AD для шифрования вне объекта, только для chacha20poly1305ietf
+        bool messageStartDetached(uint32 key[8], uint8 nonce[12], uint8 ad[_hashSize]);
+
         void messageEncipher(void* data, uint32 size);
         void messageDecipher(void* data, uint32 size);
         void mixHashUpdate(const void* data, uint32 size);
 
+        //все сегменты, при mix2Hash шифротекст подмешивается в хеш
+        void messageEncipher(Bytes& data, bool mix2Hash);
+        void messageDecipher(Bytes& data, bool mix2Hash);
+
         void messageEncipherFinish(void* macOut);
         bool messageDecipherFinish(const void* macIn);
         void mixHashFinish();
 
+    protected:
+        void defer(std::function<void()>&& op);
+
+        //отложенное исполнено целиком
+        virtual void keySettled();
+
+        //применен новый ключ
+        virtual void keyChanged();
+
+        //amount номеров кадров на текущем ключе отдаются наружу, свои кадры продолжаются после них.
+        //false если ключа еще нет или он ожидается из пула DH
+        bool leaseNonces(uint32 amount, Aead::Kind& kind, uint8 key[_keySize], uint64& nonce, uint8 ad[_hashSize]);
+
+    private:
+        void mixHashNow(const void* materialData, uint32 materialSize);
+        void mixKeyNow(const uint8 material[_keySize]);
+        void ratchetNow();
+        void exportSecretNow(const std::function<void(const uint8* secret)>& done);
+
+        void applyKey(const uint8 key[_keySize]);
+        void drainDeferred();
+
+        void processSegments(Bytes& data, bool mix2Hash, bool encipher);
+        void processRun(uint8* data, uint32 size, bool mix2Hash, bool encipher);
+
     protected:
         Handshake *                         _hs = nullptr;
         bool                                _keySetted = false;
-        dci::crypto::ChaCha20Poly1305       _aead;
+        Aead                                _aead;
+        Aead::Kind                          _pendingAead = Aead::Kind::chacha20poly1305;
+        bool                                _hasPendingAead = false;
 
         Secret<_hashSize>                   _hash;
         Secret<_hashSize>                   _chainingKey;
+        Secret<_keySize>                    _key;//текущий, для выдачи наружу
 
         dci::crypto::Blake2b                _hashMixer {_hashSize};
         dci::crypto::Hmac                   _mac4kdf {dci::crypto::Blake2b::alloc(64)};
@@ -69,5 +126,25 @@ namespace dci::module::stiac::crypto
             uint8   _raw[_nonceSize];
         } _nonce {};
         static_assert(_nonceSize == sizeof(_nonce));
+
+        //мелкие сегменты собираются в непрерывный прогон, крупные идут с границы блока
+        static constexpr uint32 _stagingSize = 4096;
+        static constexpr uint32 _stagingMaxSegments = 64;
+        static constexpr uint32 _smallSegmentSize = 256;
+        static constexpr uint32 _runAlignment = 64;
+
+        alignas(64) uint8                   _staging[_stagingSize];
+        uint64                              _messageOffset = 0;
+
+    private:
+        struct Deferred
+        {
+            bool                    _hole = false;//место под mixKey
+            bool                    _filled = false;
+            Secret<_keySize>        _material;
+            std::function<void()>   _op;
+        };
+
+        std::deque<Deferred>                _deferred;
     };
 }
@@ -0,0 +1,62 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "ticketCache.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TicketCache& TicketCache::instance()
+    {
+        static TicketCache instance;
+        return instance;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TicketCache::put(const Id& id, const Entry& entry)
+    {
+        std::unique_lock lock(_mtx);
+
+        _entries[id] = entry;
+        _order.push_back(id);
+
+        //в очереди могут быть уже извлеченные, их вытеснение ничего не стоит
+        while(_order.size() > _capacity)
+        {
+            _entries.erase(_order.front());
+            _order.pop_front();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool TicketCache::take(const Id& id, Entry& entry)
+    {
+        std::unique_lock lock(_mtx);
+
+        auto iter = _entries.find(id);
+        if(_entries.end() == iter)
+        {
+            return false;
+        }
+
+        entry = iter->second;
+        _entries.erase(iter);
+
+        return std::chrono::steady_clock::now() < entry._expire;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TicketCache::TicketCache()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TicketCache::~TicketCache()
+    {
+        _entries.clear();
+    }
+}
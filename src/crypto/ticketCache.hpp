@@ -0,0 +1,57 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "pch.hpp"
+#include "secret.hpp"
+
+namespace dci::module::stiac::crypto
+{
+    /* Билеты возобновления, выданные удаленным сторонам.
+     *
+     * Один на процесс: переподключение приходит новым экземпляром протокола. Билет
+     * одноразовый, извлекается при предъявлении; объем ограничен, при переполнении
+     * вытесняются самые старые.
+     */
+    class TicketCache
+    {
+    public:
+        static constexpr uint32 _idSize = 16;
+        static constexpr uint32 _secretSize = 32;
+        static constexpr uint32 _keySize = 32;
+
+        using Id = std::array<uint8, _idSize>;
+
+        struct Entry
+        {
+            Secret<_secretSize>                     _secret;
+            Secret<_keySize>                        _local;//свой статический открытый ключ при выдаче
+            Secret<_keySize>                        _remote;//статический ключ получателя билета
+            std::chrono::steady_clock::time_point   _expire;
+        };
+
+    public:
+        static TicketCache& instance();
+
+        void put(const Id& id, const Entry& entry);
+
+        //false если билета нет или он просрочен
+        bool take(const Id& id, Entry& entry);
+
+    private:
+        TicketCache();
+        ~TicketCache();
+
+    private:
+        static constexpr std::size_t _capacity = 4096;
+
+        std::mutex              _mtx;
+        std::map<Id, Entry>     _entries;
+        std::deque<Id>          _order;
+    };
+}
@@ -12,6 +12,45 @@ namespace dci::module::stiac
 {
     using namespace localEdge;
 
+    namespace
+    {
+        //zigzag и varint по 7 бит младшими вперед: ноль duty и первые звенья обеих сторон - один байт
+        constexpr uint32 compactIdMaxSize = 10;
+
+        void writeCompactId(link::Sink& sink, link::Id id)
+        {
+            int64 v = static_cast<int64>(id);
+            uint64 u = (static_cast<uint64>(v) << 1) ^ static_cast<uint64>(v >> 63);
+
+            while(u >= 0x80)
+            {
+                sink << static_cast<uint8>(u | 0x80);
+                u >>= 7;
+            }
+            sink << static_cast<uint8>(u);
+        }
+
+        bool readCompactId(link::Source& source, link::MirroredId& id)
+        {
+            uint64 u = 0;
+            for(uint32 i(0); i<compactIdMaxSize; ++i)
+            {
+                uint8 b;
+                source >> b;
+                u |= static_cast<uint64>(b & 0x7f) << (i*7);
+
+                if(!(b & 0x80))
+                {
+                    int64 v = static_cast<int64>(u >> 1) ^ -static_cast<int64>(u & 1);
+                    id = static_cast<link::MirroredId>(v);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     LocalEdge::LocalEdge(Protocol* protocol, const api::LocalEdge<>::Opposite& interface)
         : stages::Base(protocol)
@@ -124,12 +163,37 @@ namespace dci::module::stiac
         };
 
         //out got(interface instance) -> void;
+
+        //in streamWindow(localEdge::Stream::Opposite receiver, uint32 window) -> localEdge::Stream::Opposite;
+        _interface->streamWindow() += this * [this](apil::Stream<>::Opposite&& receiver, uint32 window)
+        {
+            switch(_state)
+            {
+            case apil::State::work:
+            case apil::State::pause:
+                break;
+
+            default:
+                return cmt::readyFuture<apil::Stream<>::Opposite>(std::make_exception_ptr(apil::BadState()));
+            }
+
+            if(!receiver)
+            {
+                return cmt::readyFuture<apil::Stream<>::Opposite>(std::make_exception_ptr(apil::BadArgument("receiver must not be null")));
+            }
+
+            localEdge::StreamWindow& sw = _streamWindows.emplace_back(this, std::move(receiver), window);
+            return cmt::readyFuture(sw.sender());
+        };
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     LocalEdge::~LocalEdge()
     {
         sbs::Owner::flush();
+        _streamWindowsReleaser.stop();
+        _streamWindowsDone.clear();
+        _streamWindows.clear();
         _localLinks.deinitialize();
         _remoteLinks.deinitialize();
         _duty.deinitialize();
@@ -156,6 +220,105 @@ namespace dci::module::stiac
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setDeduplication(uint32 threshold, uint32 cacheSize)
+    {
+        _dedup.configure(threshold, cacheSize);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setRemoteDeduplication(uint32 cacheSize)
+    {
+        _dedup.setRemoteCacheSize(cacheSize);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::resetDeduplication()
+    {
+        _dedup.reset();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setAbortThreshold(uint32 threshold)
+    {
+        _abortThreshold = threshold;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setPriorityLanes(bool enable)
+    {
+        _priorityLanes = enable;
+        Output::setPriorityLanes(enable);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setLaneRecords(std::optional<bool> enable)
+    {
+        _laneRecords = enable;
+
+        //до согласования сообщения встают по полосам как с записями, при отказе сводятся в одну
+        Output::setLaneRecords(_laneRecords.value_or(true));
+
+        if(!_laneRecords.has_value())
+        {
+            return;
+        }
+
+        Input::setLaneRecords(*_laneRecords);
+
+        if(apil::State::work == _state && Output::hasUnreleased())
+        {
+            _protocol->linkHasOutput(this);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setLengthPrefix(std::optional<bool> enable)
+    {
+        _lengthPrefix = enable;
+
+        //до согласования сообщения пишутся с длиной, при отказе она снимается
+        Output::setLengthPrefix(_lengthPrefix.value_or(true));
+
+        if(!_lengthPrefix.has_value())
+        {
+            return;
+        }
+
+        Input::setLengthPrefix(*_lengthPrefix);
+
+        if(apil::State::work == _state && Output::hasUnreleased())
+        {
+            _protocol->linkHasOutput(this);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setOutputCompactIds(bool enable)
+    {
+        _outputCompactIds = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setInputCompactIds(bool enable)
+    {
+        _inputCompactIds = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setTuidSeed(localEdge::TuidSeedPtr seed)
+    {
+        _tuidSeed = std::move(seed);
+        Input::setTuidSeed(_tuidSeed.get());
+        Output::setTuidSeed(nullptr);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::setOutputTuidSeed(bool enable)
+    {
+        Output::setTuidSeed(enable ? _tuidSeed.get() : nullptr);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint16 LocalEdge::getWantedEmptyPrefix() const
     {
@@ -165,7 +328,11 @@ namespace dci::module::stiac
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void LocalEdge::input(Bytes&& msg)
     {
-        Input::append(std::move(msg));
+        if(!Input::append(std::move(msg)))
+        {
+            inputFail("bad lane record");
+            return;
+        }
 
         if(_inputProcessingActive)
         {
@@ -176,12 +343,20 @@ namespace dci::module::stiac
 
         try
         {
-            while(apil::State::work == _state && !Input::empty())
+            while(apil::State::work == _state && Input::hasMessage())
             {
                 link::Source source = Input::makeSource();
 
                 link::MirroredId mirroredId;
-                source >> mirroredId;
+                if(!_inputCompactIds)
+                {
+                    source >> mirroredId;
+                }
+                else if(!readCompactId(source, mirroredId))
+                {
+                    source.fail("bad link id");
+                    return;
+                }
 
                 link::Id id = linkIdCast<link::Id>(mirroredId);
 
@@ -212,6 +387,12 @@ namespace dci::module::stiac
                 link->input(source);
 
                 dbgAssert(source.finalized());
+
+                if(!_dedupDecoded.empty())
+                {
+                    //восстановленное из дедуплицированного сообщение обрабатывается следующим
+                    Input::prepend(std::move(_dedupDecoded));
+                }
             }
 
             _inputProcessingActive = false;
@@ -219,16 +400,7 @@ namespace dci::module::stiac
         catch(link::source::Fail& fail)
         {
             _inputProcessingActive = false;
-
-            _state = apil::State::fail;
-            api::LocalEdge<>::Opposite interface = _interface;
-            _protocol->localEdgeFail(this, fail.details());
-
-            if(interface)
-            {
-                interface->failed(std::make_exception_ptr(apil::BadInput(fail.details())));
-                interface->stateChanged(apil::State::fail);
-            }
+            inputFail(fail.details());
         }
         catch(...)
         {
@@ -237,17 +409,75 @@ namespace dci::module::stiac
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::inputFail(const std::string& details)
+    {
+        _state = apil::State::fail;
+        api::LocalEdge<>::Opposite interface = _interface;
+        _protocol->localEdgeFail(this, details);
+
+        if(interface)
+        {
+            interface->failed(std::make_exception_ptr(apil::BadInput(details)));
+            interface->stateChanged(apil::State::fail);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool LocalEdge::hasOutput() const
+    {
+        return _laneRecords.has_value() && _lengthPrefix.has_value() && Output::hasUnreleased();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Bytes LocalEdge::flushOutput()
     {
-        return stages::Base::flushOutput();
+        if(!_laneRecords.has_value() || !_lengthPrefix.has_value())
+        {
+            return Bytes();
+        }
+
+        //порциями только ради полос и прерывания, и только если получатель соберет сообщения по длине
+        if(!*_lengthPrefix || !(_priorityLanes || _abortThreshold))
+        {
+            return Output::release(~uint32());
+        }
+
+        Bytes res = Output::release(_releaseSliceSize);
+
+        if(Output::hasUnreleased())
+        {
+            _releaseTicker.start();
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::releaseNext()
+    {
+        _releaseTicker.stop();
+
+        if(apil::State::work == _state && Output::hasUnreleased())
+        {
+            _protocol->linkHasOutput(this);
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     link::Sink LocalEdge::makeSink(link::Id id)
     {
-        link::Sink sink = Output::makeSink(_wantedEmptyPrefix);
-        sink << id;
+        link::Sink sink = Output::makeSink(_wantedEmptyPrefix, id);
+
+        if(_outputCompactIds)
+        {
+            writeCompactId(sink, id);
+        }
+        else
+        {
+            sink << id;
+        }
+
         return sink;
     }
 
@@ -260,6 +490,11 @@ namespace dci::module::stiac
             return;
         }
 
+        if(_abortThreshold)
+        {
+            abortOutput(id);
+        }
+
         auto processor = [this](int uf, auto& links, auto id)
         {
             dbgAssert(!!links.get(id));
@@ -286,12 +521,15 @@ namespace dci::module::stiac
                 (void)res;
             }
 
+            //служебное об удалении звена не должно обогнать его сообщения в других полосах
             if(uf & Hub4Link::uf_sendBegin)
             {
+                Output::orderAfter(linkIdCast<link::Id>(id));
                 _duty.linkBeginRemove(id);
             }
             if(uf & Hub4Link::uf_sendEnd)
             {
+                Output::orderAfter(linkIdCast<link::Id>(id));
                 _duty.linkEndRemove(id);
             }
         };
@@ -307,6 +545,19 @@ namespace dci::module::stiac
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::abortOutput(link::Id id)
+    {
+        //крупные сообщения ушедшего звена не нужны удаленной стороне, их невыданный остаток
+        //выбрасывается, начатое прерывается записью прерывания своей полосы
+        Output::dropUnreleased(id, _abortThreshold);
+
+        if(apil::State::work == _state && Output::hasUnreleased())
+        {
+            _protocol->linkHasOutput(this);
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool LocalEdge::emplaceLink(link::BasePtr&& link, link::RemoteId remoteId)
     {
@@ -336,6 +587,8 @@ namespace dci::module::stiac
         dbgAssert(linkPtrCopy == _localLinks.get(localId));
         linkPtrCopy->initialize(this, linkIdCast<link::Id>(localId));
 
+        Output::sinkIntroduces(linkIdCast<link::Id>(localId));
+
         return localId;
     }
 
@@ -343,6 +596,25 @@ namespace dci::module::stiac
     void LocalEdge::finalize(link::Sink& sink, bytes::Alter&& buffer)
     {
         Output::finalize(sink, std::move(buffer));
+
+        if(!_dedupEncoding && _dedup.wanted(Output::lastMessageSize()))
+        {
+            //крупное сообщение изымается и уходит через duty в дедуплицированном виде
+            _dedupEncoding = true;
+            utils::AtScopeExit cleaner{[&]
+            {
+                _dedupEncoding = false;
+            }};
+
+            link::Id id;
+            Bytes message = Output::takeLastMessage(id);
+            Bytes encoded = _dedup.encode(std::move(message));
+
+            //сообщения звена не обгоняют его дедуплицированное сообщение
+            Output::orderAfter(id);
+            _duty.dedupMessage(std::move(encoded));
+        }
+
         if(apil::State::work == _state)
         {
             _protocol->linkHasOutput(this);
@@ -442,4 +714,44 @@ namespace dci::module::stiac
 
         _remoteLinks.endRemove(remoteId);
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::oppositeDedupMessage(Bytes&& encoded)
+    {
+        if(apil::State::work != _state)
+        {
+            throw link::source::Fail("bad state");
+        }
+
+        dbgAssert(_dedupDecoded.empty());
+        if(!_dedup.decode(std::move(encoded), _dedupDecoded))
+        {
+            throw link::source::Fail("malformed dedup message");
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::streamWindowDone(localEdge::StreamWindow* sw)
+    {
+        if(_streamWindowsDone.end() == std::find(_streamWindowsDone.begin(), _streamWindowsDone.end(), sw))
+        {
+            _streamWindowsDone.push_back(sw);
+        }
+
+        _streamWindowsReleaser.start();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void LocalEdge::releaseStreamWindows()
+    {
+        _streamWindowsReleaser.stop();
+
+        std::vector<localEdge::StreamWindow*> done;
+        done.swap(_streamWindowsDone);
+
+        _streamWindows.remove_if([&done](const localEdge::StreamWindow& v)
+        {
+            return done.end() != std::find(done.begin(), done.end(), &v);
+        });
+    }
 }
@@ -15,6 +15,8 @@
 #include "localEdge/localLinks.hpp"
 #include "localEdge/remoteLinks.hpp"
 #include "localEdge/duty.hpp"
+#include "localEdge/dedup.hpp"
+#include "localEdge/streamWindow.hpp"
 
 namespace dci::module::stiac
 {
@@ -35,15 +37,38 @@ namespace dci::module::stiac
         void start();
         void pause();
 
+        void setDeduplication(uint32 threshold, uint32 cacheSize);
+        void setRemoteDeduplication(uint32 cacheSize);
+        //кеши обеих сторон начинаются заново, вызывается симметрично на обеих
+        void resetDeduplication();
+        void setAbortThreshold(uint32 threshold);
+        void setPriorityLanes(bool enable);
+
+        //записи полос согласованы маркером; пока не известно (nullopt) выход придерживается
+        void setLaneRecords(std::optional<bool> enable);
+
+        //длина перед сообщениями согласована маркером; пока не известно (nullopt) выход придерживается
+        void setLengthPrefix(std::optional<bool> enable);
+        void setOutputCompactIds(bool enable);
+        void setInputCompactIds(bool enable);
+        void setTuidSeed(localEdge::TuidSeedPtr seed);
+        void setOutputTuidSeed(bool enable);
+
     private:// Base
         uint16 getWantedEmptyPrefix() const override;
         void input(Bytes&& msg) override;
+        bool hasOutput() const override;
         Bytes flushOutput() override;
 
     private:// Hub4Link
         link::Sink makeSink(link::Id id) override;
         void linkUninvolved(link::Id id, int uf) override;
 
+    private:
+        void abortOutput(link::Id id);
+        void releaseNext();
+        void inputFail(const std::string& details);
+
     private:// Hub4Source
         bool emplaceLink(link::BasePtr&& link, link::RemoteId remoteId) override;
         void finalize(link::Source& source, bytes::Alter&& buffer) override;
@@ -62,6 +87,15 @@ namespace dci::module::stiac
         void oppositeLinkEndRemove(link::LocalId localId);
         void oppositeLinkEndRemove(link::RemoteId remoteId);
 
+        void oppositeDedupMessage(Bytes&& encoded);
+
+    public:// for StreamWindow
+        //окно не разрушается сразу: вызов идет из его же обработчиков
+        void streamWindowDone(localEdge::StreamWindow* sw);
+
+    private:
+        void releaseStreamWindows();
+
     private:
         api::LocalEdge<>::Opposite  _interface;
 
@@ -72,6 +106,35 @@ namespace dci::module::stiac
 
         bool                        _inputProcessingActive = false;
 
+        localEdge::Dedup            _dedup;
+        bool                        _dedupEncoding = false;
+        Bytes                       _dedupDecoded;
+
+        std::list<localEdge::StreamWindow>  _streamWindows;
+        std::vector<localEdge::StreamWindow*> _streamWindowsDone;
+        poll::Timer                 _streamWindowsReleaser{std::chrono::milliseconds{0}, false, [this]{releaseStreamWindows();}};
+
+        //невыданный остаток сообщений от этого размера отбрасывается при уходе звена, 0 - не отбрасывать
+        uint32                      _abortThreshold = 0;
+        bool                        _priorityLanes = false;
+
+        std::optional<bool>         _laneRecords = false;
+        std::optional<bool>         _lengthPrefix = false;
+
+        //идентификатор звена в начале сообщения: полный или сжатый (zigzag varint), вход следует объявлению удаленной стороны
+        bool                        _outputCompactIds = false;
+        bool                        _inputCompactIds = false;
+
+        //вход пользуется таблицей всегда, выход - после согласования ее версии
+        localEdge::TuidSeedPtr      _tuidSeed;
+
+        //выход отдается порциями с возвратом в цикл событий между ними: новые мелкие сообщения
+        //встают в свою полосу прежде чем уйдет следующая порция крупного, и уход звена успевает
+        //случиться до выдачи всего сообщения. Без полос и прерывания, как и без длины перед сообщениями, -
+        //целиком за раз
+        static constexpr uint32     _releaseSliceSize = 1024*256;
+        poll::Timer                 _releaseTicker{std::chrono::milliseconds{0}, false, [this]{releaseNext();}};
+
     private:
         localEdge::Duty _duty{this};
     };
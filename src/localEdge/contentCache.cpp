@@ -0,0 +1,96 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "contentCache.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ContentCache::ContentCache()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ContentCache::~ContentCache()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ContentCache::setCapacity(uint64 capacity)
+    {
+        _capacity = capacity;
+        evict();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 ContentCache::capacity() const
+    {
+        return _capacity;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ContentCache::touch(const Key& key)
+    {
+        return !!get(key);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const Bytes* ContentCache::get(const Key& key)
+    {
+        auto iter = _index.find(key);
+        if(_index.end() == iter)
+        {
+            return nullptr;
+        }
+
+        _lru.splice(_lru.begin(), _lru, iter->second);
+        return &iter->second->_content;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ContentCache::put(const Key& key, Bytes&& content, uint32 size)
+    {
+        if(size > _capacity)
+        {
+            return false;
+        }
+
+        if(touch(key))
+        {
+            return true;
+        }
+
+        _lru.push_front(Entry{key, std::move(content), size});
+        _index.emplace(key, _lru.begin());
+        _size += size;
+
+        evict();
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ContentCache::clear()
+    {
+        _index.clear();
+        _lru.clear();
+        _size = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ContentCache::evict()
+    {
+        while(_size > _capacity)
+        {
+            dbgAssert(!_lru.empty());
+
+            Entry& victim = _lru.back();
+            _size -= victim._size;
+            _index.erase(victim._key);
+            _lru.pop_back();
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+#include "../pch.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    //LRU по объему, ключ - хеш содержимого
+    class ContentCache
+    {
+    public:
+        static constexpr uint32 _keySize = 32;
+        using Key = std::array<uint8, _keySize>;
+
+    public:
+        ContentCache();
+        ~ContentCache();
+
+        void setCapacity(uint64 capacity);
+        uint64 capacity() const;
+
+        //наличие с продвижением в голову LRU
+        bool touch(const Key& key);
+        const Bytes* get(const Key& key);
+
+        //size учитывается в объеме даже если content пуст (модель кеша удаленной стороны)
+        bool put(const Key& key, Bytes&& content, uint32 size);
+
+        void clear();
+
+    private:
+        void evict();
+
+    private:
+        struct Entry
+        {
+            Key     _key;
+            Bytes   _content;
+            uint32  _size;
+        };
+
+        using Lru = std::list<Entry>;
+        Lru                             _lru;
+        std::map<Key, Lru::iterator>    _index;
+
+        uint64  _capacity = 0;
+        uint64  _size = 0;
+    };
+}
@@ -0,0 +1,284 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "dedup.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    namespace
+    {
+        constexpr std::array<uint64, 256> gearTable = []
+        {
+            //splitmix64
+            std::array<uint64, 256> res {};
+            uint64 state = 0;
+            for(uint64& v : res)
+            {
+                state += 0x9e3779b97f4a7c15;
+                uint64 z = state;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                v = z ^ (z >> 31);
+            }
+            return res;
+        }();
+
+        //старшие биты gear-хеша зависят от последних 64 байт, в среднем кусок ~16к сверх минимального
+        constexpr uint64 cutMask = ((uint64(1) << 14) - 1) << (64 - 14);
+
+        Bytes copyOf(const Bytes& src)
+        {
+            Bytes res;
+            bytes::Alter dst(res.end());
+
+            bytes::Cursor c(src.begin());
+            while(!c.atEnd())
+            {
+                dst.write(c.continuousData(), c.continuousDataSize());
+                c.advanceChunks(1);
+            }
+
+            return res;
+        }
+
+        void writeUint32(bytes::Alter& dst, uint32 v)
+        {
+            v = stiac::serialization::fixEndian(v);
+            dst.write(&v, sizeof(v));
+        }
+
+        bool readUint32(bytes::Alter& src, uint32& v)
+        {
+            if(sizeof(v) != src.removeTo(&v, sizeof(v)))
+            {
+                return false;
+            }
+
+            v = stiac::serialization::fixEndian(v);
+            return true;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Dedup::Dedup()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Dedup::~Dedup()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Dedup::configure(uint32 threshold, uint32 cacheSize)
+    {
+        _threshold = threshold;
+        _cacheSize = cacheSize;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Dedup::setRemoteCacheSize(uint32 cacheSize)
+    {
+        _remoteCacheSize = cacheSize;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Dedup::wanted(uint32 messageSize) const
+    {
+        return _threshold && _cacheSize && _remoteCacheSize && messageSize >= _threshold;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Dedup::encode(Bytes&& message)
+    {
+        Bytes res;
+        bytes::Alter dst(res.end());
+
+        uint32 capacity = std::min(_cacheSize, _remoteCacheSize);
+        _remote.setCapacity(capacity);
+        writeUint32(dst, capacity);
+
+        for(uint32 chunkSize : cut(message))
+        {
+            Bytes chunk;
+            message.begin().removeTo(chunk, chunkSize);
+            dbgAssert(chunk.size() == chunkSize);
+
+            if(chunkSize < _minChunkSize)
+            {
+                uint8 kind = rk_literalNoCache;
+                dst.write(&kind, sizeof(kind));
+                writeUint32(dst, chunkSize);
+                dst.write(std::move(chunk));
+                continue;
+            }
+
+            ContentCache::Key key = keyOf(chunk);
+
+            if(_remote.touch(key))
+            {
+                uint8 kind = rk_reference;
+                dst.write(&kind, sizeof(kind));
+                dst.write(key.data(), key.size());
+                continue;
+            }
+
+            _remote.put(key, Bytes(), chunkSize);
+
+            uint8 kind = rk_literal;
+            dst.write(&kind, sizeof(kind));
+            writeUint32(dst, chunkSize);
+            dst.write(key.data(), key.size());
+            dst.write(std::move(chunk));
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Dedup::decode(Bytes&& encoded, Bytes& message)
+    {
+        bytes::Alter src(encoded.begin());
+
+        uint32 capacity;
+        if(!readUint32(src, capacity))
+        {
+            return false;
+        }
+
+        if(capacity > _cacheSize)
+        {
+            //удаленная сторона хочет больше чем разрешено локально
+            return false;
+        }
+
+        _local.setCapacity(capacity);
+
+        while(!src.atEnd())
+        {
+            uint8 kind;
+            src.removeTo(&kind, sizeof(kind));
+
+            switch(kind)
+            {
+            case rk_literal:
+            case rk_literalNoCache:
+                {
+                    uint32 size;
+                    if(!readUint32(src, size))
+                    {
+                        return false;
+                    }
+
+                    ContentCache::Key key;
+                    if(rk_literal == kind && key.size() != src.removeTo(key.data(), key.size()))
+                    {
+                        return false;
+                    }
+
+                    Bytes chunk;
+                    src.removeTo(chunk, size);
+                    if(chunk.size() != size)
+                    {
+                        return false;
+                    }
+
+                    if(rk_literal == kind)
+                    {
+                        _local.put(key, copyOf(chunk), size);
+                    }
+
+                    message.end().write(std::move(chunk));
+                }
+                break;
+
+            case rk_reference:
+                {
+                    ContentCache::Key key;
+                    if(key.size() != src.removeTo(key.data(), key.size()))
+                    {
+                        return false;
+                    }
+
+                    const Bytes* content = _local.get(key);
+                    if(!content)
+                    {
+                        return false;
+                    }
+
+                    message.end().write(copyOf(*content));
+                }
+                break;
+
+            default:
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Dedup::reset()
+    {
+        _remote.clear();
+        _local.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint32> Dedup::cut(const Bytes& message) const
+    {
+        std::vector<uint32> res;
+
+        uint64 hash = 0;
+        uint32 size = 0;
+
+        bytes::Cursor c(message.begin());
+        while(!c.atEnd())
+        {
+            const uint8* data = static_cast<const uint8*>(static_cast<const void*>(c.continuousData()));
+            uint32 dataSize = c.continuousDataSize();
+
+            for(uint32 i(0); i<dataSize; ++i)
+            {
+                hash = (hash << 1) + gearTable[data[i]];
+                ++size;
+
+                if(size >= _maxChunkSize || (size >= _minChunkSize && !(hash & cutMask)))
+                {
+                    res.push_back(size);
+                    size = 0;
+                    hash = 0;
+                }
+            }
+
+            c.advanceChunks(1);
+        }
+
+        if(size)
+        {
+            res.push_back(size);
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ContentCache::Key Dedup::keyOf(const Bytes& chunk)
+    {
+        bytes::Cursor c(chunk.begin());
+        while(!c.atEnd())
+        {
+            _hasher.add(c.continuousData(), c.continuousDataSize());
+            c.advanceChunks(1);
+        }
+
+        ContentCache::Key key;
+        _hasher.finish(key.data());
+        return key;
+    }
+}
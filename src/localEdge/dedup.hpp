@@ -0,0 +1,73 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "../pch.hpp"
+#include "contentCache.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    /* Дедупликация крупных сообщений.
+     *
+     * Сообщение режется на куски по содержимому (gear-хеш), куски идентифицируются
+     * хешем blake2b. Отправитель ведет модель кеша получателя, получатель - сам кеш,
+     * обе стороны вытесняют по одному и тому же LRU с объемом, объявленным отправителем
+     * в каждом сообщении, поэтому модель точна и подтверждения не требуются.
+     * Отправитель кодирует не больше объема, объявленного получателем, и не дедуплицирует
+     * вовсе, пока получатель не объявил ненулевой объем.
+     *
+     * Формат (все числа little endian):
+     *  uint32 capacity
+     *  записи до конца:
+     *      uint8 kind
+     *          rk_literal:         uint32 size, key, size байт; содержимое кешируется
+     *          rk_reference:       key
+     *          rk_literalNoCache:  uint32 size, size байт
+     */
+    class Dedup
+    {
+    public:
+        Dedup();
+        ~Dedup();
+
+        void configure(uint32 threshold, uint32 cacheSize);
+
+        //объем, объявленный удаленной стороной, 0 - она не принимает дедуплицированное
+        void setRemoteCacheSize(uint32 cacheSize);
+        bool wanted(uint32 messageSize) const;
+
+        Bytes encode(Bytes&& message);
+        bool decode(Bytes&& encoded, Bytes& message);
+
+        void reset();
+
+    private:
+        enum RecordKind : uint8
+        {
+            rk_literal          = 0,
+            rk_reference        = 1,
+            rk_literalNoCache   = 2,
+        };
+
+        static constexpr uint32 _minChunkSize = 1024*4;
+        static constexpr uint32 _maxChunkSize = 1024*64;
+
+        std::vector<uint32> cut(const Bytes& message) const;
+        ContentCache::Key keyOf(const Bytes& chunk);
+
+    private:
+        uint32                  _threshold = 0;
+        uint32                  _cacheSize = 0;
+        uint32                  _remoteCacheSize = 0;
+
+        ContentCache            _remote;//модель кеша удаленной стороны
+        ContentCache            _local;
+
+        dci::crypto::Blake2b    _hasher {ContentCache::_keySize};
+    };
+}
@@ -69,6 +69,14 @@ namespace dci::module::stiac::localEdge
                     remoteId);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Duty::dedupMessage(Bytes&& encoded)
+    {
+        return call2Bin<void>(
+                    link::MethodId(9),
+                    std::move(encoded));
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Duty::input(link::Source& source)
     {
@@ -113,6 +121,12 @@ namespace dci::module::stiac::localEdge
                 return _le->oppositeLinkEndRemove(localId);
             });
 
+        case 9://dedupMessage
+            return bin2Call<void, Bytes>(source, [&](Bytes&& encoded)
+            {
+                return _le->oppositeDedupMessage(std::move(encoded));
+            });
+
         default:
             {
                 source.fail("malformed input");
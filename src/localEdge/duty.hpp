@@ -32,6 +32,8 @@ namespace dci::module::stiac::localEdge
         void linkEndRemove(link::LocalId localId);
         void linkEndRemove(link::RemoteId remoteId);
 
+        void dedupMessage(Bytes&& encoded);
+
     private:
         void input(link::Source& source) override;
         void destroy() override;
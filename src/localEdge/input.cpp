@@ -20,9 +20,104 @@ namespace dci::module::stiac::localEdge
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Input::append(Bytes&& data)
+    bool Input::append(Bytes&& data)
     {
-        _data.end().write(std::move(data));
+        if(!_lengthPrefix)
+        {
+            _data.end().write(std::move(data));
+            return true;
+        }
+
+        if(!_laneRecords)
+        {
+            Bytes& lane = _lanes[static_cast<uint8>(Lane::interactive)];
+            lane.end().write(std::move(data));
+            collect(lane);
+            return true;
+        }
+
+        _records.end().write(std::move(data));
+
+        for(;;)
+        {
+            if(!_recordRest)
+            {
+                if(_records.size() < LaneRecord::_headerSize)
+                {
+                    //не хватает заголовка записи
+                    return true;
+                }
+
+                std::array<uint8, LaneRecord::_headerSize> header;
+                _records.begin().removeTo(header.data(), header.size());
+
+                uint8 lane = header[0] & ~LaneRecord::_abortFlag;
+                uint32 size;
+                std::memcpy(&size, header.data()+1, sizeof(size));
+                size = stiac::serialization::fixEndian(size);
+
+                if(lane >= LaneRecord::_lanesAmount)
+                {
+                    return false;
+                }
+
+                if(header[0] & LaneRecord::_abortFlag)
+                {
+                    if(size)
+                    {
+                        return false;
+                    }
+
+                    //в полосе остается только начатое, целые уже ушли в _data
+                    _lanes[lane].clear();
+                    continue;
+                }
+
+                if(!size)
+                {
+                    return false;
+                }
+
+                _recordLane = lane;
+                _recordRest = size;
+            }
+
+            if(_records.empty())
+            {
+                return true;
+            }
+
+            Bytes& lane = _lanes[_recordLane];
+
+            uint32 amount = std::min(_recordRest, _records.size());
+            Bytes part;
+            _records.begin().removeTo(part, amount);
+            lane.end().write(std::move(part));
+            _recordRest -= amount;
+
+            collect(lane);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Input::setLaneRecords(bool enable)
+    {
+        _laneRecords = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Input::setLengthPrefix(bool enable)
+    {
+        _lengthPrefix = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Input::prepend(Bytes&& data)
+    {
+        dbgAssert(!_hasActiveSource);
+
+        data.end().write(std::move(_data));
+        _data = std::move(data);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -31,11 +126,74 @@ namespace dci::module::stiac::localEdge
         return _data.empty();
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Input::hasMessage()
+    {
+        if(!_lengthPrefix)
+        {
+            return !_data.empty();
+        }
+
+        uint32 length;
+        if(_data.size() < sizeof(length))
+        {
+            return false;
+        }
+
+        _data.begin().read(&length, sizeof(length));
+        length = stiac::serialization::fixEndian(length);
+
+        return _data.size() - sizeof(length) >= length;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Input::setTuidSeed(const TuidSeed* seed)
+    {
+        _tuidSeed = seed;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Input::collect(Bytes& lane)
+    {
+        for(;;)
+        {
+            uint32 length;
+            if(lane.size() < sizeof(length))
+            {
+                return;
+            }
+
+            lane.begin().read(&length, sizeof(length));
+            length = stiac::serialization::fixEndian(length);
+
+            if(lane.size() - sizeof(length) < length)
+            {
+                return;
+            }
+
+            if(lane.size() - sizeof(length) == length)
+            {
+                _data.end().write(std::move(lane));
+                return;
+            }
+
+            Bytes message;
+            lane.begin().removeTo(message, sizeof(length) + length);
+            _data.end().write(std::move(message));
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     link::Source Input::makeSource()
     {
         dbgAssert(!_hasActiveSource);
-        dbgAssert(!empty());
+        dbgAssert(hasMessage());
+
+        if(_lengthPrefix)
+        {
+            //длина нужна только для ожидания целого сообщения
+            _data.begin().remove(sizeof(uint32));
+        }
 
         _hasActiveSource = true;
         return link::Source(this, _data.begin());
@@ -54,14 +212,19 @@ namespace dci::module::stiac::localEdge
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Input::mapTuid(uint32& mapped, const std::array<uint8, 16>& tuid)
     {
-        auto res = _tuidMapFwd.try_emplace(tuid, _tuidMapFwd.size());
+        if(_tuidMapFwd.size() >= TuidSeed::_base)
+        {
+            return false;
+        }
+
+        auto res = _tuidMapFwd.tryEmplace(tuid, _tuidMapFwd.size());
 
         if(!res.second)
         {
             return false;
         }
 
-        mapped = res.first->second;
+        mapped = res.first;
         dbgAssert(_tuidMapBwd.size() == mapped);
 
         _tuidMapBwd.emplace_back(tuid);
@@ -72,6 +235,11 @@ namespace dci::module::stiac::localEdge
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Input::unmapTuid(const uint32& mapped, std::array<uint8, 16>& tuid)
     {
+        if(mapped >= TuidSeed::_base)
+        {
+            return _tuidSeed && _tuidSeed->unmap(mapped, tuid);
+        }
+
         if(_tuidMapBwd.size() <= mapped)
         {
             return false;
@@ -8,9 +8,16 @@
 #pragma once
 
 #include "../pch.hpp"
+#include "lanes.hpp"
+#include "tuidMap.hpp"
 
 namespace dci::module::stiac::localEdge
 {
+    //Source читает прямо из накопленного входа, прочитанное изымается из _data в finalize;
+    //своих копий здесь нет, крупные bytes десериализатор может забрать сегментами.
+    //С длиной впереди вход может приходить частями, записи полос (lanes.hpp) собираются по полосам,
+    //целые сообщения переходят в _data в порядке завершения, разбор только по ним. Без длины
+    //ступени выше отдают только целые сообщения
     class Input
         : public dci::stiac::link::Hub4Source
     {
@@ -18,8 +25,20 @@ namespace dci::module::stiac::localEdge
         Input();
         ~Input() override;
 
-        void append(Bytes&& data);
+        //ложь - испорченные записи полос
+        bool append(Bytes&& data);
+
+        //без записей полос вход - сообщения подряд
+        void setLaneRecords(bool enable);
+
+        //без длины вход - целые сообщения без нее
+        void setLengthPrefix(bool enable);
+        void prepend(Bytes&& data);
         bool empty() const;
+        bool hasMessage();
+
+        //собственная таблица известных tuid, номера из нее удаленная сторона шлет по согласованию версии
+        void setTuidSeed(const TuidSeed* seed);
 
         link::Source makeSource();
 
@@ -29,14 +48,23 @@ namespace dci::module::stiac::localEdge
         bool mapTuid(uint32& mapped, const std::array<uint8, 16>& tuid) override;
         bool unmapTuid(const uint32& mapped, std::array<uint8, 16>& tuid) override;
 
+    private:
+        void collect(Bytes& lane);
+
     private:
         Bytes _data;
 
+        bool _laneRecords = false;
+        bool _lengthPrefix = false;
+        Bytes _records;
+        uint8 _recordLane = 0;
+        uint32 _recordRest = 0;
+        std::array<Bytes, LaneRecord::_lanesAmount> _lanes;
+
         bool _hasActiveSource = false;
 
-        using TuidMapFwd = std::map<std::array<uint8, 16>, uint32>;
-        using TuidMapBwd = std::vector<std::array<uint8, 16>>;
-        TuidMapFwd _tuidMapFwd;
-        TuidMapBwd _tuidMapBwd;
+        const TuidSeed* _tuidSeed = nullptr;
+        TuidMap _tuidMapFwd;
+        std::vector<Tuid> _tuidMapBwd;
     };
 }
@@ -0,0 +1,42 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "../pch.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    /* Полосы выходного потока LocalEdge.
+     *
+     * Поток режется на записи, каждая несет порцию одной полосы:
+     *  uint8 полоса | флаг прерывания
+     *  uint32 размер (little endian)
+     *  размер байт
+     *
+     * Внутри полосы идут сообщения подряд (каждое с uint32 длиной впереди), запись может
+     * заканчиваться посреди сообщения, продолжение придет следующей записью той же полосы.
+     * Запись с флагом прерывания пустая, принятое начатое сообщение полосы отбрасывается.
+     *
+     * Записи пишутся только когда обе стороны их объявили (маркер), иначе поток - просто
+     * сообщения подряд одной полосой, начатое сообщение не прерывается.
+     */
+    enum class Lane : uint8
+    {
+        control     = 0,//служебное duty
+        interactive = 1,//мелкие вызовы
+        bulk        = 2,//крупные сообщения
+    };
+
+    struct LaneRecord
+    {
+        static constexpr uint32 _lanesAmount    = 3;
+        static constexpr uint32 _headerSize     = 1 + sizeof(uint32);
+        static constexpr uint8  _abortFlag      = 0x80;
+    };
+}
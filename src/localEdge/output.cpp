@@ -22,23 +22,152 @@ namespace dci::module::stiac::localEdge
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    link::Sink Output::makeSink(uint32 reserveIfCan)
+    void Output::setPriorityLanes(bool enable)
+    {
+        _priorityLanes = enable;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::setLaneRecords(bool enable)
+    {
+        _laneRecords = enable;
+
+        if(_laneRecords)
+        {
+            return;
+        }
+
+        //поставленное до согласования еще не выдавалось, сводится в одну полосу в порядке постановки
+        Bytes data;
+        std::deque<Message> messages;
+
+        for(;;)
+        {
+            LaneQueue* src = nullptr;
+            for(LaneQueue& q : _lanes)
+            {
+                dbgAssert(!q._headReleased && !q._aborted);
+                if(!q._messages.empty() && (!src || q._messages.front()._seq < src->_messages.front()._seq))
+                {
+                    src = &q;
+                }
+            }
+
+            if(!src)
+            {
+                break;
+            }
+
+            Bytes message;
+            src->_data.begin().removeTo(message, src->_messages.front()._size);
+            data.end().write(std::move(message));
+            messages.push_back(std::move(src->_messages.front()));
+            src->_messages.pop_front();
+        }
+
+        LaneQueue& dst = _lanes[static_cast<uint8>(Lane::interactive)];
+        dst._data = std::move(data);
+        dst._messages = std::move(messages);
+
+        for(auto& [id, order] : _unfinished)
+        {
+            for(auto& [seq, lane] : order)
+            {
+                lane = Lane::interactive;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::setLengthPrefix(bool enable)
+    {
+        if(_lengthPrefix == enable)
+        {
+            return;
+        }
+
+        _lengthPrefix = enable;
+
+        //поставленное до согласования еще не выдавалось, длина снимается или добавляется каждому
+        for(LaneQueue& q : _lanes)
+        {
+            dbgAssert(!q._headReleased && !q._aborted);
+            Bytes data;
+
+            for(Message& m : q._messages)
+            {
+                Bytes message;
+                q._data.begin().removeTo(message, m._size);
+
+                if(_lengthPrefix)
+                {
+                    uint32 length = stiac::serialization::fixEndian(m._size);
+                    data.end().write(&length, sizeof(length));
+                    m._size += _lengthPrefixSize;
+                }
+                else
+                {
+                    message.begin().remove(_lengthPrefixSize);
+                    m._size -= _lengthPrefixSize;
+                }
+
+                data.end().write(std::move(message));
+            }
+
+            q._data = std::move(data);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::setTuidSeed(const TuidSeed* seed)
+    {
+        _tuidSeed = seed;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    link::Sink Output::makeSink(uint32 reserveIfCan, link::Id id)
     {
         dbgAssert(!_hasActiveSink);
         _hasActiveSink = true;
+        _sinkId = id;
+        _sinkIntroduces.clear();
 
         dbgAssert(!_reserved);
+        dbgAssert(_data.empty());
 
+        //сообщение целиком уходит в полосу, буфер всегда пуст и место под заголовок записи есть
         bytes::Alter a(_data.end());
-        if(reserveIfCan && !a.sizeBack())
+        if(!a.sizeBack())
+        {
+            _reserved = reserveIfCan + LaneRecord::_headerSize;
+            a.advance(static_cast<int32>(_reserved));
+        }
+
+        if(_lengthPrefix)
         {
-            _reserved = reserveIfCan;
-            a.advance(static_cast<int32>(reserveIfCan));
+            //место под длину, заполняется в finalize
+            uint32 length = 0;
+            a.write(&length, sizeof(length));
         }
 
         return link::Sink(this, std::move(a));
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::orderAfter(link::Id id)
+    {
+        _orderAfter = id;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::sinkIntroduces(link::Id id)
+    {
+        if(_hasActiveSink)
+        {
+            _sinkIntroduces.push_back(id);
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Output::finalize(link::Sink& sink, bytes::Alter&& buffer)
     {
@@ -58,12 +187,345 @@ namespace dci::module::stiac::localEdge
         {
             bytes::Alter{std::move(buffer)};
         }
+
+        uint32 size = _data.size();
+        if(_lengthPrefix)
+        {
+            dbgAssert(size >= _lengthPrefixSize);
+            uint32 length = stiac::serialization::fixEndian(size - _lengthPrefixSize);
+            _data.begin().write(&length, sizeof(length));
+        }
+
+        //по размеру; уже поставленные сообщения того же звена в других полосах его придержат при выдаче
+        link::Id orderId = linkIsNull(_orderAfter) ? _sinkId : _orderAfter;
+        _orderAfter = link::Id::null;
+
+        Lane lane = laneFor(size);
+
+        LaneQueue& q = _lanes[static_cast<uint8>(lane)];
+        q._data.end().write(std::move(_data));
+        q._messages.push_back(Message{orderId, std::move(_sinkIntroduces), size, _seq++});
+        _sinkIntroduces.clear();
+        _lastLane = lane;
+
+        unfinished(q._messages.back(), lane);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Output::lastMessageSize() const
+    {
+        dbgAssert(!_hasActiveSink);
+        const LaneQueue& q = _lanes[static_cast<uint8>(_lastLane)];
+        dbgAssert(!q._messages.empty());
+        return q._messages.back()._size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Output::takeLastMessage(link::Id& id)
+    {
+        dbgAssert(!_hasActiveSink);
+
+        LaneQueue& q = _lanes[static_cast<uint8>(_lastLane)];
+        dbgAssert(!q._messages.empty());
+        dbgAssert(q._messages.size() > 1 || !q._headReleased);
+
+        Message& m = q._messages.back();
+        id = m._id;
+        finished(m);
+
+        Bytes res;
+
+        bytes::Alter a(q._data.begin());
+        a.advance(static_cast<int32>(q._data.size() - m._size));
+        a.removeTo(res, m._size);
+
+        q._messages.pop_back();
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Output::release(uint32 budget)
+    {
+        dbgAssert(!_hasActiveSink);
+
+        Bytes res;
+
+        for(uint8 l(0); l<LaneRecord::_lanesAmount; ++l)
+        {
+            LaneQueue& q = _lanes[l];
+
+            if(q._aborted)
+            {
+                q._aborted = false;
+
+                std::array<uint8, LaneRecord::_headerSize> header {};
+                header[0] = l | LaneRecord::_abortFlag;
+                res.end().write(header.data(), header.size());
+            }
+
+            uint32 laneBudget = Lane::bulk == static_cast<Lane>(l) ? std::max(budget, _bulkMinimum) : budget;
+            uint32 amount = releasable(static_cast<Lane>(l), laneBudget);
+
+            if(amount)
+            {
+                releaseLane(res, static_cast<Lane>(l), amount);
+                budget -= std::min(budget, amount);
+            }
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Output::hasUnreleased() const
+    {
+        for(const LaneQueue& q : _lanes)
+        {
+            if(!q._data.empty() || q._aborted)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::dropUnreleased(link::Id id, uint32 minSize)
+    {
+        dbgAssert(!_hasActiveSink);
+
+        for(LaneQueue& q : _lanes)
+        {
+            uint32 offset = 0;
+
+            for(auto iter = q._messages.begin(); iter != q._messages.end(); )
+            {
+                bool isHead = q._messages.begin() == iter;
+                uint32 unreleased = iter->_size - (isHead ? q._headReleased : 0);
+
+                //введенные сообщением звенья удаленная сторона должна увидеть, такое досылается
+                if(id != iter->_id || iter->_size < minSize || !iter->_introduces.empty())
+                {
+                    offset += unreleased;
+                    ++iter;
+                    continue;
+                }
+
+                if(isHead && q._headReleased && !_laneRecords)
+                {
+                    //без записей полос начатое не прервать, досылается
+                    offset += unreleased;
+                    ++iter;
+                    continue;
+                }
+
+                bytes::Alter a(q._data.begin());
+                a.advance(static_cast<int32>(offset));
+                a.remove(unreleased);
+
+                if(isHead && q._headReleased)
+                {
+                    //начало уже ушло, получатель отбросит его по записи прерывания
+                    q._headReleased = 0;
+                    q._aborted = true;
+                }
+
+                finished(*iter);
+                iter = q._messages.erase(iter);
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Lane Output::laneFor(uint32 size) const
+    {
+        if(!_priorityLanes || !_laneRecords)
+        {
+            return Lane::interactive;
+        }
+
+        if(size >= _bulkThreshold)
+        {
+            return Lane::bulk;
+        }
+
+        return linkIsNull(_sinkId) ? Lane::control : Lane::interactive;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Output::releasable(Lane lane, uint32 budget) const
+    {
+        const LaneQueue& q = _lanes[static_cast<uint8>(lane)];
+
+        if(!_laneRecords)
+        {
+            //одна полоса, обгонять некому
+            return std::min(budget, q._data.size());
+        }
+
+        //сообщения подряд от начала полосы, пока не встретится обгоняющее свое звено
+        uint32 res = 0;
+        for(auto iter = q._messages.begin(); iter != q._messages.end() && res < budget; ++iter)
+        {
+            if(overtakes(*iter, lane))
+            {
+                break;
+            }
+
+            res += iter->_size - (q._messages.begin() == iter ? q._headReleased : 0);
+        }
+
+        return std::min(res, budget);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Output::overtakes(const Message& m, Lane lane) const
+    {
+        auto check = [&](link::Id id)
+        {
+            auto iter = _unfinished.find(id);
+            if(_unfinished.end() == iter)
+            {
+                return false;
+            }
+
+            //более раннее того же звена в своей полосе уйдет раньше само, в чужой - ждать его окончания
+            for(const auto& [seq, l] : iter->second)
+            {
+                if(seq >= m._seq)
+                {
+                    return false;
+                }
+
+                if(l != lane)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        if(!linkIsNull(m._id) && check(m._id))
+        {
+            return true;
+        }
+
+        for(link::Id id : m._introduces)
+        {
+            if(check(id))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::unfinished(const Message& m, Lane lane)
+    {
+        if(!linkIsNull(m._id))
+        {
+            _unfinished[m._id].emplace_back(m._seq, lane);
+        }
+
+        for(link::Id id : m._introduces)
+        {
+            _unfinished[id].emplace_back(m._seq, lane);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::finished(const Message& m)
+    {
+        auto drop = [&](link::Id id)
+        {
+            auto iter = _unfinished.find(id);
+            if(_unfinished.end() == iter)
+            {
+                return;
+            }
+
+            std::deque<std::pair<uint64, Lane>>& order = iter->second;
+            auto pos = std::find_if(order.begin(), order.end(), [&](const auto& v){return v.first == m._seq;});
+            if(order.end() != pos)
+            {
+                order.erase(pos);
+            }
+
+            if(order.empty())
+            {
+                _unfinished.erase(iter);
+            }
+        };
+
+        if(!linkIsNull(m._id))
+        {
+            drop(m._id);
+        }
+
+        for(link::Id id : m._introduces)
+        {
+            drop(id);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Output::releaseLane(Bytes& res, Lane lane, uint32 amount)
+    {
+        LaneQueue& q = _lanes[static_cast<uint8>(lane)];
+        dbgAssert(amount && amount <= q._data.size());
+
+        Bytes record;
+        q._data.begin().removeTo(record, amount);
+
+        if(_laneRecords)
+        {
+            std::array<uint8, LaneRecord::_headerSize> header;
+            header[0] = static_cast<uint8>(lane);
+
+            uint32 size = stiac::serialization::fixEndian(amount);
+            std::memcpy(header.data()+1, &size, sizeof(size));
+
+            //писать заголовок перед данными, у первой порции сообщения место зарезервировано
+            bytes::Alter alter(record.begin());
+            alter.advance(-static_cast<int32>(header.size()));
+            alter.write(header.data(), header.size());
+        }
+
+        res.end().write(std::move(record));
+
+        while(amount)
+        {
+            dbgAssert(!q._messages.empty());
+            Message& head = q._messages.front();
+
+            uint32 part = std::min(amount, head._size - q._headReleased);
+            q._headReleased += part;
+            amount -= part;
+
+            if(q._headReleased == head._size)
+            {
+                finished(head);
+                q._messages.pop_front();
+                q._headReleased = 0;
+            }
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     std::pair<uint32, bool> Output::mapTuid(const std::array<uint8, 16>& tuid)
     {
-        auto res = _tuidMap.try_emplace(tuid, uint32(_tuidMap.size()));
-        return std::make_pair(res.first->second, res.second);
+        uint32 mapped;
+        if(_tuidSeed && _tuidSeed->map(mapped, tuid))
+        {
+            return std::make_pair(mapped, false);
+        }
+
+        dbgAssert(_tuidMap.size() < TuidSeed::_base);
+        return _tuidMap.tryEmplace(tuid, _tuidMap.size());
     }
 }
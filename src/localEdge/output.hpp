@@ -8,9 +8,15 @@
 #pragma once
 
 #include "../pch.hpp"
+#include "lanes.hpp"
+#include "tuidMap.hpp"
 
 namespace dci::module::stiac::localEdge
 {
+    //сообщения пишутся прямо в выходной буфер ступени, Sink получает Alter на его конец;
+    //своих копий здесь нет, крупные bytes сериализатор может вклеить сегментами.
+    //Каждое сообщение (с uint32 длиной впереди, если она согласована) по завершении уходит в свою полосу,
+    //выдача вниз по цепи - записями полос (lanes.hpp); резать поток ступени ниже вправе только при длине
     class Output
         : public link::Hub4Sink
     {
@@ -18,19 +24,95 @@ namespace dci::module::stiac::localEdge
         Output(Bytes& data);
         ~Output() override;
 
-        link::Sink makeSink(uint32 reserveIfCan);
+        static constexpr uint32 _lengthPrefixSize = sizeof(uint32);
+
+        void setPriorityLanes(bool enable);
+
+        //без записей полос выход - сообщения подряд, уже поставленное сводится в одну полосу
+        void setLaneRecords(bool enable);
+
+        //без длины сообщения идут подряд целыми, уже поставленное переписывается под выбранное
+        void setLengthPrefix(bool enable);
+
+        //заранее известные tuid, только когда удаленная сторона подтвердила ту же версию таблицы
+        void setTuidSeed(const TuidSeed* seed);
+
+        link::Sink makeSink(uint32 reserveIfCan, link::Id id);
+
+        //следующее сообщение относится к звену id: не обгоняет его поставленные сообщения и не обгоняется последующими.
+        //Сообщение звена в другой полосе не выдается, пока не выдано целиком более раннее того же звена
+        void orderAfter(link::Id id);
+
+        //звено создано сериализатором внутри текущего сообщения
+        void sinkIntroduces(link::Id id);
+
+        uint32 lastMessageSize() const;
+        Bytes takeLastMessage(link::Id& id);
+
+        //выдача вниз по цепи порциями, крупное сообщение может уйти за несколько проходов
+        Bytes release(uint32 budget);
+        bool hasUnreleased() const;
+
+        //изъять невыданное крупных сообщений звена, начатые прерываются записью прерывания
+        void dropUnreleased(link::Id id, uint32 minSize);
 
         link::LocalId emplaceLink(link::BasePtr&& link) override = 0;
         void finalize(link::Sink& sink, bytes::Alter&& buffer) override;
         std::pair<uint32, bool> mapTuid(const std::array<uint8, 16>& tuid) override;
 
+    private:
+        struct Message;
+
+        Lane laneFor(uint32 size) const;
+        uint32 releasable(Lane lane, uint32 budget) const;
+        bool overtakes(const Message& m, Lane lane) const;
+        void unfinished(const Message& m, Lane lane);
+        void finished(const Message& m);
+        void releaseLane(Bytes& res, Lane lane, uint32 amount);
+
     private:
         Bytes& _data;
 
         bool _hasActiveSink = false;
         uint32 _reserved = 0;
+        link::Id _sinkId = link::Id::null;
+        link::Id _orderAfter = link::Id::null;
+        std::vector<link::Id> _sinkIntroduces;
+
+        //крупные уходят по своей полосе
+        static constexpr uint32 _bulkThreshold = 1024*64;
+
+        //крупным не меньше этого за проход, даже если мелкие выбрали весь бюджет
+        static constexpr uint32 _bulkMinimum = 1024*64;
+
+        bool _priorityLanes = false;
+        bool _laneRecords = false;
+        bool _lengthPrefix = false;
+
+        struct Message
+        {
+            link::Id                _id;
+            std::vector<link::Id>   _introduces;
+            uint32                  _size;
+            uint64                  _seq;
+        };
+
+        struct LaneQueue
+        {
+            Bytes               _data;
+            std::deque<Message> _messages;
+            uint32              _headReleased = 0;
+            bool                _aborted = false;
+        };
+
+        std::array<LaneQueue, LaneRecord::_lanesAmount> _lanes;
+        Lane _lastLane = Lane::interactive;
+
+        //невыданные целиком сообщения каждого звена (и введенных сообщением) по порядку постановки и их полосы
+        uint64 _seq = 0;
+        std::map<link::Id, std::deque<std::pair<uint64, Lane>>> _unfinished;
 
-        using TuidMap = std::map<std::array<uint8, 16>, uint32>;
+        const TuidSeed* _tuidSeed = nullptr;
         TuidMap _tuidMap;
     };
 }
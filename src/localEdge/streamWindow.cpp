@@ -0,0 +1,218 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "streamWindow.hpp"
+#include "../localEdge.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    StreamWindow::StreamWindow(LocalEdge* le, apil::Stream<>::Opposite&& receiver, uint32 window)
+        : _le{le}
+        , _receiver{std::move(receiver)}
+        , _window{std::max(window, uint32(1))}
+    {
+        _local.init();
+
+        //out chunk(bytes data) -> none;
+        _local->chunk() += this * [this](Bytes&& data)
+        {
+            return chunk(std::move(data));
+        };
+
+        //out finish() -> none;
+        _local->finish() += this * [this]()
+        {
+            return finish();
+        };
+
+        _local.involvedChanged() += this * [this](bool v)
+        {
+            if(!v && !_finishing)
+            {
+                //отправитель бросил поток не закончив
+                _le->streamWindowDone(this);
+            }
+        };
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    StreamWindow::~StreamWindow()
+    {
+        sbs::Owner::flush();
+
+        while(!_pending.empty())
+        {
+            _pending.front()._promise.resolveException(std::make_exception_ptr(apil::BadState()));
+            _pending.pop();
+        }
+
+        if(_finishing && !_finishDone)
+        {
+            _finished.resolveException(std::make_exception_ptr(apil::BadState()));
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    apil::Stream<>::Opposite StreamWindow::sender()
+    {
+        return _local.opposite();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    cmt::Future<None> StreamWindow::chunk(Bytes&& data)
+    {
+        if(_finishing)
+        {
+            return cmt::readyFuture<None>(std::make_exception_ptr(apil::BadState()));
+        }
+
+        if(_failure)
+        {
+            return cmt::readyFuture<None>(_failure);
+        }
+
+        if(_pending.empty() && windowOpened())
+        {
+            send(std::move(data));
+            return cmt::readyFuture(None{});
+        }
+
+        _pending.emplace();
+        _pending.back()._data = std::move(data);
+        return _pending.back()._promise.future();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    cmt::Future<None> StreamWindow::finish()
+    {
+        if(_finishing)
+        {
+            return cmt::readyFuture<None>(std::make_exception_ptr(apil::BadState()));
+        }
+
+        _finishing = true;
+        cmt::Future<None> res = _finished.future();
+
+        if(_failure)
+        {
+            _finishDone = true;
+            _finished.resolveException(_failure);
+            _le->streamWindowDone(this);
+            return res;
+        }
+
+        acked(0);
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StreamWindow::send(Bytes&& data)
+    {
+        uint32 size = data.size();
+        _inFlight += size;
+
+        _receiver->chunk(std::move(data)).then() += this * [this, size](auto in)
+        {
+            if(in.resolvedException())
+            {
+                try
+                {
+                    in.value();
+                }
+                catch(...)
+                {
+                    failed(std::current_exception());
+                }
+            }
+
+            acked(size);
+        };
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StreamWindow::acked(uint32 size)
+    {
+        dbgAssert(_inFlight >= size);
+        _inFlight -= size;
+
+        if(_failure)
+        {
+            return;
+        }
+
+        while(!_pending.empty() && windowOpened())
+        {
+            Pending p = std::move(_pending.front());
+            _pending.pop();
+
+            send(std::move(p._data));
+            p._promise.resolveValue(None{});
+        }
+
+        if(_finishing && !_finishSent && _pending.empty() && !_inFlight)
+        {
+            _finishSent = true;
+            _receiver->finish().then() += this * [this](auto in)
+            {
+                _finishDone = true;
+
+                if(in.resolvedException())
+                {
+                    try
+                    {
+                        in.value();
+                    }
+                    catch(...)
+                    {
+                        _finished.resolveException(std::current_exception());
+                    }
+                }
+                else
+                {
+                    _finished.resolveValue(None{});
+                }
+
+                _le->streamWindowDone(this);
+            };
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StreamWindow::failed(ExceptionPtr e)
+    {
+        if(_failure)
+        {
+            return;
+        }
+
+        _failure = e;
+
+        while(!_pending.empty())
+        {
+            _pending.front()._promise.resolveException(_failure);
+            _pending.pop();
+        }
+
+        //finish получателю еще не ушел - ждать нечего
+        if(_finishing && !_finishSent)
+        {
+            _finishDone = true;
+            _finished.resolveException(_failure);
+            _le->streamWindowDone(this);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool StreamWindow::windowOpened() const
+    {
+        //пустое окно пропускает хотя бы одну порцию любого размера
+        return !_inFlight || _inFlight < _window;
+    }
+}
@@ -0,0 +1,69 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+#include "../pch.hpp"
+
+namespace dci::module::stiac
+{
+    class LocalEdge;
+}
+
+namespace dci::module::stiac::localEdge
+{
+    /* Окно отправки в поток.
+     *
+     * Порции пересылаются получателю сразу, отправителю подтверждаются пока неподтвержденных
+     * получателем байт меньше окна. Сверх окна порция ждет в очереди и подтверждается
+     * отправителю только когда окно освободится, так что добросовестный отправитель держит
+     * в полете не больше окна плюс одну порцию. finish уходит получателю после всех порций.
+     * Отказ получателя отдается отправителю: ожидающие порции и finish завершаются тем же
+     * исключением, дальнейшие порции не принимаются.
+     */
+    class StreamWindow
+        : private sbs::Owner
+    {
+    public:
+        StreamWindow(LocalEdge* le, apil::Stream<>::Opposite&& receiver, uint32 window);
+        ~StreamWindow();
+
+        apil::Stream<>::Opposite sender();
+
+    private:
+        cmt::Future<None> chunk(Bytes&& data);
+        cmt::Future<None> finish();
+
+        void send(Bytes&& data);
+        void acked(uint32 size);
+        void failed(ExceptionPtr e);
+        bool windowOpened() const;
+
+    private:
+        LocalEdge *                 _le;
+
+        apil::Stream<>::Opposite    _receiver;
+        apil::Stream<>              _local;
+
+        uint32                      _window;
+        uint64                      _inFlight = 0;
+
+        struct Pending
+        {
+            Bytes               _data;
+            cmt::Promise<None>  _promise;
+        };
+        std::queue<Pending>         _pending;
+
+        bool                        _finishing = false;
+        bool                        _finishSent = false;
+        bool                        _finishDone = false;
+        cmt::Promise<None>          _finished;
+
+        ExceptionPtr                _failure;
+    };
+}
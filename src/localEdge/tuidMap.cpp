@@ -0,0 +1,158 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "tuidMap.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TuidMap::TuidMap()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TuidMap::~TuidMap()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::pair<uint32, bool> TuidMap::tryEmplace(const Tuid& tuid, uint32 value)
+    {
+        //заполнение не выше 3/4
+        if((_size + 1) * 4 > _slots.size() * 3)
+        {
+            grow();
+        }
+
+        Slot& slot = _slots[slotFor(tuid)];
+        if(slot._busy)
+        {
+            return std::make_pair(slot._value, false);
+        }
+
+        slot._tuid = tuid;
+        slot._value = value;
+        slot._busy = true;
+        ++_size;
+
+        return std::make_pair(value, true);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const uint32* TuidMap::find(const Tuid& tuid) const
+    {
+        if(!_size)
+        {
+            return nullptr;
+        }
+
+        const Slot& slot = _slots[slotFor(tuid)];
+        return slot._busy ? &slot._value : nullptr;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 TuidMap::size() const
+    {
+        return _size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TuidMap::clear()
+    {
+        _slots.clear();
+        _size = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t TuidMap::slotFor(const Tuid& tuid) const
+    {
+        dbgAssert(!_slots.empty());
+
+        uint64 hash;
+        std::memcpy(&hash, tuid.data(), sizeof(hash));
+
+        //емкость - степень двойки
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t idx(hash & mask); ; idx = (idx + 1) & mask)
+        {
+            const Slot& slot = _slots[idx];
+            if(!slot._busy || slot._tuid == tuid)
+            {
+                return idx;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TuidMap::grow()
+    {
+        std::vector<Slot> old = std::exchange(_slots, std::vector<Slot>(std::max(_initialCapacity, _slots.size() * 2)));
+
+        for(const Slot& slot : old)
+        {
+            if(slot._busy)
+            {
+                _slots[slotFor(slot._tuid)] = slot;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TuidSeed::TuidSeed(uint32 version)
+        : _version{version}
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TuidSeed::~TuidSeed()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TuidSeed::add(const Tuid& tuid)
+    {
+        //повторы пропускаются, номер - позиция первого вхождения
+        if(_index.tryEmplace(tuid, static_cast<uint32>(_tuids.size())).second)
+        {
+            _tuids.push_back(tuid);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 TuidSeed::version() const
+    {
+        return _version;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool TuidSeed::map(uint32& mapped, const Tuid& tuid) const
+    {
+        const uint32* idx = _index.find(tuid);
+        if(!idx)
+        {
+            return false;
+        }
+
+        mapped = _base + *idx;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool TuidSeed::unmap(uint32 mapped, Tuid& tuid) const
+    {
+        dbgAssert(mapped >= _base);
+        uint32 idx = mapped - _base;
+
+        if(idx >= _tuids.size())
+        {
+            return false;
+        }
+
+        tuid = _tuids[idx];
+        return true;
+    }
+}
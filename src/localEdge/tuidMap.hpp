@@ -0,0 +1,73 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "../pch.hpp"
+
+namespace dci::module::stiac::localEdge
+{
+    using Tuid = std::array<uint8, 16>;
+
+    //tuid -> uint32, открытая адресация с линейным пробированием в одном массиве;
+    //tuid случайны, хешем служат их первые 8 байт
+    class TuidMap
+    {
+    public:
+        TuidMap();
+        ~TuidMap();
+
+        //значение и признак вставки, существующее не меняется
+        std::pair<uint32, bool> tryEmplace(const Tuid& tuid, uint32 value);
+        const uint32* find(const Tuid& tuid) const;
+
+        uint32 size() const;
+        void clear();
+
+    private:
+        std::size_t slotFor(const Tuid& tuid) const;
+        void grow();
+
+    private:
+        struct Slot
+        {
+            Tuid    _tuid {};
+            uint32  _value = 0;
+            bool    _busy = false;
+        };
+
+        static constexpr std::size_t _initialCapacity = 32;
+
+        std::vector<Slot>   _slots;
+        uint32              _size = 0;
+    };
+
+    //заранее известная обеим сторонам таблица tuid, согласуется версией в маркере.
+    //Номера из нее уходят со смещением _base и не пересекаются с номерами, назначаемыми по ходу
+    class TuidSeed
+    {
+    public:
+        static constexpr uint32 _base = uint32(1) << 24;
+
+    public:
+        TuidSeed(uint32 version);
+        ~TuidSeed();
+
+        void add(const Tuid& tuid);
+
+        uint32 version() const;
+        bool map(uint32& mapped, const Tuid& tuid) const;
+        bool unmap(uint32 mapped, Tuid& tuid) const;
+
+    private:
+        uint32              _version;
+        std::vector<Tuid>   _tuids;
+        TuidMap             _index;
+    };
+
+    using TuidSeedPtr = std::shared_ptr<const TuidSeed>;
+}
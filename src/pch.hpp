@@ -18,16 +18,25 @@
 #include <dci/host/exception.hpp>
 #include <dci/logger.hpp>
 #include <dci/poll/timer.hpp>
+#include <dci/poll/descriptor.hpp>
 
 #include "stiac.hpp"
 
 #include <queue>
+#include <list>
+#include <deque>
+#include <map>
+#include <optional>
+#include <bit>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
 
 #include <zstd.h>
 
-#include <boost/crc.hpp>
-
 namespace dci::module::stiac
 {
     using namespace dci;
@@ -81,6 +81,133 @@ namespace dci::module::stiac
             }
         };
 
+        //in setAuthRemote(protocol::PublicKey remote);
+        methods()->setAuthRemote() += sol() * [this](apip::PublicKey remote)
+        {
+            if(_paramAuthRemote != remote)
+            {
+                _paramAuthRemote = std::move(remote);
+                paramsChanged(epc_authRemote);
+            }
+        };
+
+        //in setEarlyPayload(bool enable);
+        methods()->setEarlyPayload() += sol() * [this](bool enable)
+        {
+            if(_paramEarlyPayload != enable)
+            {
+                _paramEarlyPayload = enable;
+                paramsChanged(epc_earlyPayload);
+            }
+        };
+
+        //in setResumption(uint32 lifetime);
+        methods()->setResumption() += sol() * [this](uint32 lifetime)
+        {
+            _paramResumptionLifetime = lifetime;
+
+            if(_handshake)
+            {
+                _handshake->setResumption(_paramResumptionLifetime);
+            }
+        };
+
+        //in setResumptionTicket(protocol::ResumptionTicket ticket);
+        methods()->setResumptionTicket() += sol() * [this](apip::ResumptionTicket ticket)
+        {
+            _paramResumptionTicket = std::move(ticket);
+            paramsChanged(epc_resumptionTicket);
+        };
+
+        //in setAeads(protocol::Aead aeads);
+        methods()->setAeads() += sol() * [this](apip::Aead aeads)
+        {
+            if(_paramAeads != aeads)
+            {
+                _paramAeads = aeads;
+                paramsChanged(epc_aeads);
+            }
+        };
+
+        //in setMaxFrameSize(uint32 size);
+        methods()->setMaxFrameSize() += sol() * [this](uint32 size)
+        {
+            size = std::clamp(size, crypto::Handshake::_shortFrameSize, crypto::Handshake::_longFrameSizeLimit);
+
+            if(_paramMaxFrameSize != size)
+            {
+                _paramMaxFrameSize = size;
+                paramsChanged(epc_maxFrameSize);
+            }
+        };
+
+        //in setMaxChunkSize(uint32 size);
+        methods()->setMaxChunkSize() += sol() * [this](uint32 size)
+        {
+            size = std::min(size, crypto::Handshake::_longFrameSizeLimit);
+
+            if(_paramMaxChunkSize != size)
+            {
+                _paramMaxChunkSize = size;
+                paramsChanged(epc_maxChunkSize);
+            }
+        };
+
+        //in setRekeyPolicy(uint32 messages, uint64 bytes, uint32 seconds);
+        methods()->setRekeyPolicy() += sol() * [this](uint32 messages, uint64 bytes, uint32 seconds)
+        {
+            _paramRekeyMessages = messages;
+            _paramRekeyBytes = bytes;
+            _paramRekeySeconds = seconds;
+
+            if(_handshake)
+            {
+                _handshake->setRekeyPolicy(_paramRekeyMessages, _paramRekeyBytes, _paramRekeySeconds);
+            }
+        };
+
+        //in setRatchet(uint32 perDh);
+        methods()->setRatchet() += sol() * [this](uint32 perDh)
+        {
+            if(_paramRatchet != perDh)
+            {
+                _paramRatchet = perDh;
+                paramsChanged(epc_ratchet);
+            }
+        };
+
+        //in setHandshakeOffload(bool enable);
+        methods()->setHandshakeOffload() += sol() * [this](bool enable)
+        {
+            _paramHandshakeOffload = enable;
+
+            if(_handshake)
+            {
+                _handshake->setOffload(_paramHandshakeOffload);
+            }
+        };
+
+        //in setKeyPool(bool enable);
+        methods()->setKeyPool() += sol() * [this](bool enable)
+        {
+            _paramKeyPool = enable;
+
+            if(_handshake)
+            {
+                _handshake->setKeyPool(_paramKeyPool);
+            }
+        };
+
+        //in setChecksum(protocol::Checksum checksum);
+        methods()->setChecksum() += sol() * [this](apip::Checksum checksum)
+        {
+            if(_paramChecksum != checksum)
+            {
+                _paramChecksum = checksum;
+                paramsChanged(epc_checksum);
+            }
+        };
+
         //in setLocalEdge(LocalEdge::Opposite local);
         methods()->setLocalEdge() += sol() * [this](api::LocalEdge<>::Opposite local)
         {
@@ -101,6 +228,114 @@ namespace dci::module::stiac
             }
         };
 
+        //in setDeduplication(uint32 threshold, uint32 cacheSize);
+        methods()->setDeduplication() += sol() * [this](uint32 threshold, uint32 cacheSize)
+        {
+            _paramDedupThreshold = threshold;
+
+            //объем кеша объявлен удаленной стороне маркером, его смена - заново
+            if(_paramDedupCacheSize != cacheSize)
+            {
+                _paramDedupCacheSize = cacheSize;
+                paramsChanged(epc_dedup);
+            }
+
+            if(_localEdge)
+            {
+                _localEdge->setDeduplication(_paramDedupThreshold, _paramDedupCacheSize);
+            }
+        };
+
+        //in setBatchCiphering(bool enable);
+        methods()->setBatchCiphering() += sol() * [this](bool enable)
+        {
+            _paramBatchCiphering = enable;
+
+            if(_outCiphering)
+            {
+                _outCiphering->setBatching(_paramBatchCiphering);
+            }
+        };
+
+        //in setAbortThreshold(uint32 threshold);
+        methods()->setAbortThreshold() += sol() * [this](uint32 threshold)
+        {
+            bool laneRecords = laneRecordsWanted();
+            _paramAbortThreshold = threshold;
+
+            if(laneRecords != laneRecordsWanted())
+            {
+                paramsChanged(epc_laneRecords);
+            }
+
+            if(_localEdge)
+            {
+                _localEdge->setAbortThreshold(_paramAbortThreshold);
+            }
+        };
+
+        //in setPriorityLanes(bool enable);
+        methods()->setPriorityLanes() += sol() * [this](bool enable)
+        {
+            bool laneRecords = laneRecordsWanted();
+            _paramPriorityLanes = enable;
+
+            if(laneRecords != laneRecordsWanted())
+            {
+                paramsChanged(epc_laneRecords);
+            }
+
+            if(_localEdge)
+            {
+                _localEdge->setPriorityLanes(_paramPriorityLanes);
+            }
+        };
+
+        //in setLengthPrefix(bool enable);
+        methods()->setLengthPrefix() += sol() * [this](bool enable)
+        {
+            if(_paramLengthPrefix != enable)
+            {
+                _paramLengthPrefix = enable;
+                paramsChanged(epc_lengthPrefix);
+            }
+        };
+
+        //in setCompactIds(bool enable);
+        methods()->setCompactIds() += sol() * [this](bool enable)
+        {
+            if(_paramCompactIds != enable)
+            {
+                _paramCompactIds = enable;
+                paramsChanged(epc_compactIds);
+            }
+        };
+
+        //in setTuidTable(uint32 version, protocol::TuidTable tuids);
+        methods()->setTuidTable() += sol() * [this](uint32 version, apip::TuidTable tuids)
+        {
+            if(_paramTuidVersion == version && _paramTuidTable == tuids)
+            {
+                return;
+            }
+
+            std::shared_ptr<localEdge::TuidSeed> seed;
+
+            if(!tuids.empty())
+            {
+                seed = std::make_shared<localEdge::TuidSeed>(version);
+                for(const auto& tuid : tuids)
+                {
+                    seed->add(tuid);
+                }
+            }
+
+            _paramTuidVersion = version;
+            _paramTuidTable = std::move(tuids);
+            _paramTuidSeed = std::move(seed);
+            paramsChanged(epc_tuidTable);
+        };
+
         //in start();
         methods()->start() += sol() * [this]()
         {
@@ -153,6 +388,57 @@ namespace dci::module::stiac
 
         //out statusChanged(protocol::State state);
 
+        //in stats() -> protocol::Stats;
+        methods()->stats() += sol() * [this]()
+        {
+            apip::Stats res {};
+
+            if(_handshake)
+            {
+                res.rekeys = _handshake->rekeys();
+                res.remoteRekeys = _handshake->remoteRekeys();
+                res.ratchets = _handshake->ratchets();
+                res.remoteRatchets = _handshake->remoteRatchets();
+                res.resumed = _handshake->resumed();
+            }
+
+            if(_inCiphering)
+            {
+                res.inputBufferedPeak = _inCiphering->bufferedPeak();
+            }
+
+            return readyFuture(std::move(res));
+        };
+
+        //in exportOutputKeys(uint32 frames) -> protocol::SessionKeys;
+        methods()->exportOutputKeys() += sol() * [this](uint32 frames)
+        {
+            apip::SessionKeys res {};
+
+            //внутри прохода прокачки порядок выдачи относительно выделенных номеров не гарантировать
+            if(!_outCiphering || _pumpingInProgress)
+            {
+                return cmt::readyFuture<apip::SessionKeys>(std::make_exception_ptr(apip::BadState()));
+            }
+
+            //все поставленное раньше получает свои номера и уходит пользователю до выделения
+            _remoteOutputEager = true;
+            doPump();
+
+            bool exported = _outCiphering->exportKeys(frames, res);
+
+            //смена ключа перед выделением - тоже до ответа
+            _remoteOutputEager = true;
+            doPump();
+
+            if(!exported)
+            {
+                return cmt::readyFuture<apip::SessionKeys>(std::make_exception_ptr(apip::BadState()));
+            }
+
+            return readyFuture(std::move(res));
+        };
+
         //in remoteAutorization() -> protocol::Key;
         methods()->remoteAuth() += sol() * [this]()
         {
@@ -179,6 +465,7 @@ namespace dci::module::stiac
         dbgAssert(!_pumpingInProgress);
         _hasOutputFlags = 0;
         _delayedAutoPumpTicker.stop();
+        _lazyOutputTicker.stop();
 
         while(!_remoteAuthWaiters.empty())
         {
@@ -201,6 +488,8 @@ namespace dci::module::stiac
 
         crypto::cleanMemoryUnder(_paramAuthPrologue);
         crypto::cleanMemoryUnder(_paramAuthLocal);
+        crypto::cleanMemoryUnder(_paramAuthRemote);
+        crypto::cleanMemoryUnder(_paramResumptionTicket.secret);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -245,15 +534,76 @@ namespace dci::module::stiac
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     std::vector<uint8> Protocol::protocolMarker()
     {
+        std::vector<uint8> options;
+
+        if(_handshake && static_cast<uint8>(apip::Aead::chacha20poly1305) != _handshake->aeads())
+        {
+            options.push_back(mo_aeads);
+            options.push_back(1);
+            options.push_back(_handshake->aeads());
+        }
+
+        if(_paramMaxFrameSize > crypto::Handshake::_shortFrameSize)
+        {
+            uint32 v = stiac::serialization::fixEndian(_paramMaxFrameSize);
+            options.push_back(mo_maxFrameSize);
+            options.push_back(sizeof(v));
+            const uint8* raw = static_cast<const uint8*>(static_cast<const void*>(&v));
+            options.insert(options.end(), raw, raw + sizeof(v));
+        }
+
+        if(_handshake && _handshake->ratchet())
+        {
+            options.push_back(mo_ratchet);
+            options.push_back(0);
+        }
+
+        if(_paramCompactIds)
+        {
+            options.push_back(mo_compactIds);
+            options.push_back(0);
+        }
+
+        if(laneRecordsWanted())
+        {
+            options.push_back(mo_laneRecords);
+            options.push_back(0);
+        }
+
+        if(lengthPrefixWanted())
+        {
+            options.push_back(mo_lengthPrefix);
+            options.push_back(0);
+        }
+
+        if(_paramDedupCacheSize)
+        {
+            uint32 v = stiac::serialization::fixEndian(_paramDedupCacheSize);
+            options.push_back(mo_dedup);
+            options.push_back(sizeof(v));
+            const uint8* raw = static_cast<const uint8*>(static_cast<const void*>(&v));
+            options.insert(options.end(), raw, raw + sizeof(v));
+        }
+
+        if(_paramTuidSeed)
+        {
+            uint32 v = stiac::serialization::fixEndian(_paramTuidSeed->version());
+            options.push_back(mo_tuidTable);
+            options.push_back(sizeof(v));
+            const uint8* raw = static_cast<const uint8*>(static_cast<const void*>(&v));
+            options.insert(options.end(), raw, raw + sizeof(v));
+        }
+
         Marker m
         {
-            ._version = 0,
+            ._version = static_cast<uint8>(options.empty() ? 0 : 1),
             ._inputRequirements = static_cast<uint8>(_paramInputRequirements),
             ._outputRequirements = static_cast<uint8>(_paramOutputRequirements)
         };
 
         std::vector<uint8> res(sizeof(Marker));
         std::memcpy(res.data(), &m, sizeof(Marker));
+        res.insert(res.end(), options.begin(), options.end());
         return res;
     }
 
@@ -261,7 +611,7 @@ namespace dci::module::stiac
     void Protocol::handshakeProtocolMarker(std::vector<uint8> remote)
     {
         static_assert(3 == sizeof(Marker));
-        if(3 != remote.size())
+        if(sizeof(Marker) > remote.size())
         {
             if(1 <= remote.size())
             {
@@ -279,7 +629,7 @@ namespace dci::module::stiac
         Marker m;
         std::memcpy(&m, remote.data(), sizeof(Marker));
 
-        if(m._version != 0)
+        if(m._version > 1 || (0 == m._version && sizeof(Marker) != remote.size()))
         {
             apip::BadRemoteVersion e;
             e.version = m._version;
@@ -287,6 +637,98 @@ namespace dci::module::stiac
             return;
         }
 
+        uint8 remoteAeads = static_cast<uint8>(apip::Aead::chacha20poly1305);
+        uint32 remoteMaxFrameSize = crypto::Handshake::_shortFrameSize;
+        bool remoteRatchet = false;
+        bool remoteCompactIds = false;
+        std::optional<uint32> remoteTuidVersion;
+        uint32 remoteDedupCacheSize = 0;
+        bool remoteLaneRecords = false;
+        bool remoteLengthPrefix = false;
+
+        for(std::size_t pos(sizeof(Marker)); pos < remote.size(); )
+        {
+            if(pos + 2 > remote.size() || pos + 2 + remote[pos+1] > remote.size())
+            {
+                apip::BadRemoteMarker e;
+                fail(e);
+                return;
+            }
+
+            uint8 tag = remote[pos];
+            uint8 size = remote[pos+1];
+            const uint8* value = remote.data() + pos + 2;
+            pos += 2 + size;
+
+            switch(tag)
+            {
+            case mo_aeads:
+                if(1 != size)
+                {
+                    apip::BadRemoteMarker e;
+                    fail(e);
+                    return;
+                }
+                remoteAeads = value[0];
+                break;
+
+            case mo_maxFrameSize:
+                if(sizeof(remoteMaxFrameSize) != size)
+                {
+                    apip::BadRemoteMarker e;
+                    fail(e);
+                    return;
+                }
+                std::memcpy(&remoteMaxFrameSize, value, sizeof(remoteMaxFrameSize));
+                remoteMaxFrameSize = stiac::serialization::fixEndian(remoteMaxFrameSize);
+                break;
+
+            case mo_ratchet:
+                remoteRatchet = true;
+                break;
+
+            case mo_compactIds:
+                remoteCompactIds = true;
+                break;
+
+            case mo_tuidTable:
+                {
+                    uint32 v;
+                    if(sizeof(v) != size)
+                    {
+                        apip::BadRemoteMarker e;
+                        fail(e);
+                        return;
+                    }
+                    std::memcpy(&v, value, sizeof(v));
+                    remoteTuidVersion = stiac::serialization::fixEndian(v);
+                }
+                break;
+
+            case mo_laneRecords:
+                remoteLaneRecords = true;
+                break;
+
+            case mo_lengthPrefix:
+                remoteLengthPrefix = true;
+                break;
+
+            case mo_dedup:
+                if(sizeof(remoteDedupCacheSize) != size)
+                {
+                    apip::BadRemoteMarker e;
+                    fail(e);
+                    return;
+                }
+                std::memcpy(&remoteDedupCacheSize, value, sizeof(remoteDedupCacheSize));
+                remoteDedupCacheSize = stiac::serialization::fixEndian(remoteDedupCacheSize);
+                break;
+
+            default:
+                break;
+            }
+        }
+
         apip::Requirements rOut = static_cast<apip::Requirements>(m._outputRequirements);
         apip::Requirements rInp = static_cast<apip::Requirements>(m._inputRequirements);
 
@@ -319,6 +761,44 @@ namespace dci::module::stiac
         }
 
         dbgAssert(_effectiveInputRequirements == rOut);
+
+        if(_handshake)
+        {
+            _handshake->remoteAeads(remoteAeads);
+            _handshake->remoteRatchet(remoteRatchet);
+        }
+
+        if(_outCiphering)
+        {
+            _outCiphering->setMaxFrameSize(std::min(_paramMaxFrameSize, remoteMaxFrameSize));
+        }
+
+        //маркер удаленной стороны идет в ее потоке раньше любого сообщения
+        if(_localEdge)
+        {
+            _localEdge->setInputCompactIds(remoteCompactIds);
+
+            //номера из таблицы уходят только если у удаленной стороны та же ее версия
+            _localEdge->setOutputTuidSeed(_paramTuidSeed && remoteTuidVersion == _paramTuidSeed->version());
+            //объемы объявлены заново в новой сессии, удаленная сторона тоже начинает с пустого кеша
+            _localEdge->resetDeduplication();
+            _localEdge->setRemoteDeduplication(remoteDedupCacheSize);
+            _localEdge->setLengthPrefix(lengthPrefixWanted() && remoteLengthPrefix);
+            _localEdge->setLaneRecords(laneRecordsWanted() && remoteLaneRecords);
+        }
+
+        //длина перед сообщениями в обоих направлениях или ни в одном, вход ступеней шифрования и сжатия по ней же
+        bool lengthPrefix = lengthPrefixWanted() && remoteLengthPrefix;
+
+        if(_inCiphering)
+        {
+            _inCiphering->setStreaming(lengthPrefix);
+        }
+
+        if(_outCompression)
+        {
+            _outCompression->setSliced(lengthPrefix);
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -337,6 +817,19 @@ namespace dci::module::stiac
         methods()->remoteAuthChanged(remote);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Protocol::handshakeResumptionTicket(apip::ResumptionTicket&& ticket)
+    {
+        methods()->resumptionTicket(ticket);
+        crypto::cleanMemoryUnder(ticket.secret);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Protocol::outputKeyChanged()
+    {
+        methods()->outputKeyChanged();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Protocol::handshakeFail(const std::string& details)
     {
@@ -397,8 +890,8 @@ namespace dci::module::stiac
 
             //шифрование должно быть одинаковым с обоих сторон
             if(
-               (apip::Requirements::ciphering & _effectiveInputRequirements) !=
-               (apip::Requirements::ciphering & _effectiveOutputRequirements))
+               secured(_effectiveInputRequirements) != secured(_effectiveOutputRequirements) ||
+               authenticationOnly(_effectiveInputRequirements) != authenticationOnly(_effectiveOutputRequirements))
             {
                 fail(apip::BadRequirements("ciphering requirement must be equal for input and output"));
                 return false;
@@ -426,9 +919,11 @@ namespace dci::module::stiac
 
         ////////////////////////////////////////////////////
         // inCiphering
-        if(apip::Requirements::ciphering == (apip::Requirements::ciphering & _effectiveInputRequirements))
+        if(secured(_effectiveInputRequirements))
         {
             push2Chain(_inCiphering, this);
+            _inCiphering->setMaxFrameSize(_paramMaxFrameSize);
+            _inCiphering->setStreaming(false);
         }
         else
         {
@@ -439,6 +934,9 @@ namespace dci::module::stiac
                 push2Chain(_inCutting,
                            this,
                            apip::Requirements::integrity == (apip::Requirements::integrity & _effectiveInputRequirements));
+                _inCutting->setChecksum(static_cast<stages::Checksum::Kind>(_paramChecksum));
+                _inCutting->setMaxChunkSize(_paramMaxChunkSize);
+                _inCutting->setStreaming(lengthPrefixWanted());
             }
         }
 
@@ -464,6 +962,52 @@ namespace dci::module::stiac
             }
 
             push2Chain(_localEdge, this, _paramLocalEdge);
+
+            //без шифрования объем не согласуется, его смена должна быть на обеих сторонах - обе и сбросят
+            if(epc_dedup & _paramsChanging)
+            {
+                _localEdge->resetDeduplication();
+            }
+
+            _localEdge->setDeduplication(_paramDedupThreshold, _paramDedupCacheSize);
+            _localEdge->setRemoteDeduplication(secured(_effectiveOutputRequirements) ? 0 : _paramDedupCacheSize);
+            _localEdge->setAbortThreshold(_paramAbortThreshold);
+            _localEdge->setPriorityLanes(_paramPriorityLanes);
+
+            //с шифрованием записи полос только если их объявят обе стороны, до маркера удаленной
+            //стороны выход придерживается; без шифрования обе стороны должны задать одинаково
+            if(!laneRecordsWanted())
+            {
+                _localEdge->setLaneRecords(false);
+            }
+            else if(secured(_effectiveOutputRequirements))
+            {
+                _localEdge->setLaneRecords(std::nullopt);
+            }
+            else
+            {
+                _localEdge->setLaneRecords(true);
+            }
+
+            //длина перед сообщениями так же: без нее сообщения идут целыми, как у прежних версий
+            if(!lengthPrefixWanted())
+            {
+                _localEdge->setLengthPrefix(false);
+            }
+            else if(secured(_effectiveOutputRequirements))
+            {
+                _localEdge->setLengthPrefix(std::nullopt);
+            }
+            else
+            {
+                _localEdge->setLengthPrefix(true);
+            }
+
+            //с шифрованием вход объявляется маркером удаленной стороны, без него маркера нет
+            _localEdge->setOutputCompactIds(_paramCompactIds);
+            _localEdge->setInputCompactIds(!secured(_effectiveInputRequirements) && _paramCompactIds);
+            _localEdge->setTuidSeed(_paramTuidSeed);
+            _localEdge->setOutputTuidSeed(!secured(_effectiveOutputRequirements) && _paramTuidSeed);
         }
 
         ////////////////////////////////////////////////////
@@ -471,13 +1015,18 @@ namespace dci::module::stiac
         if(!!(apip::Requirements::compression & _effectiveOutputRequirements))
         {
             push2Chain(_outCompression, this);
+            _outCompression->setSliced(!secured(_effectiveOutputRequirements) && lengthPrefixWanted());
         }
 
-        if(apip::Requirements::ciphering == (apip::Requirements::ciphering & _effectiveOutputRequirements))
+        if(secured(_effectiveOutputRequirements))
         {
             ////////////////////////////////////////////////////
             // outCiphering
             push2Chain(_outCiphering, this);
+            _outCiphering->setBatching(_paramBatchCiphering);
+
+            //длинные кадры только после маркера удаленной стороны
+            _outCiphering->setMaxFrameSize(crypto::Handshake::_shortFrameSize);
         }
         else
         {
@@ -488,6 +1037,8 @@ namespace dci::module::stiac
                 push2Chain(_outCutting,
                            this,
                            apip::Requirements::integrity == (apip::Requirements::integrity & _effectiveOutputRequirements));
+                _outCutting->setChecksum(static_cast<stages::Checksum::Kind>(_paramChecksum));
+                _outCutting->setMaxChunkSize(_paramMaxChunkSize);
             }
         }
 
@@ -520,7 +1071,7 @@ namespace dci::module::stiac
         }
 
         ////////////////////////////////////////////////////
-        if(apip::Requirements::ciphering == (apip::Requirements::ciphering & _effectiveInputRequirements))
+        if(secured(_effectiveInputRequirements))
         {
             if(!_handshake)
             {
@@ -531,7 +1082,26 @@ namespace dci::module::stiac
 
                 _handshake->setAuth(
                             _paramAuthPrologue,
-                            _paramAuthLocal);
+                            _paramAuthLocal,
+                            _paramAuthRemote);
+                _handshake->setEarlyPayload(_paramEarlyPayload);
+
+                _handshake->setRekeyPolicy(_paramRekeyMessages, _paramRekeyBytes, _paramRekeySeconds);
+                _handshake->setRatchet(_paramRatchet);
+                _handshake->setOffload(_paramHandshakeOffload);
+                _handshake->setKeyPool(_paramKeyPool);
+                _handshake->setResumption(_paramResumptionLifetime);
+                _handshake->setResumptionTicket(_paramResumptionTicket);
+
+                //без шифрования - только MAC, иначе MAC-only из разрешенных исключается
+                if(authenticationOnly(_effectiveInputRequirements))
+                {
+                    _handshake->setAeads(static_cast<uint8>(apip::Aead::poly1305));
+                }
+                else
+                {
+                    _handshake->setAeads(static_cast<uint8>(_paramAeads) & uint8(~static_cast<uint8>(apip::Aead::poly1305)));
+                }
             }
         }
 
@@ -541,6 +1111,36 @@ namespace dci::module::stiac
         return true;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Protocol::secured(apip::Requirements requirements)
+    {
+        return
+            apip::Requirements::ciphering == (apip::Requirements::ciphering & requirements) ||
+            apip::Requirements::authentication == (apip::Requirements::authentication & requirements);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Protocol::authenticationOnly(apip::Requirements requirements)
+    {
+        return
+            apip::Requirements::ciphering != (apip::Requirements::ciphering & requirements) &&
+            apip::Requirements::authentication == (apip::Requirements::authentication & requirements);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Protocol::laneRecordsWanted() const
+    {
+        //прерывание начатого и чередование полос требуют записей полос
+        return _paramPriorityLanes || _paramAbortThreshold;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Protocol::lengthPrefixWanted() const
+    {
+        //записи полос режут сообщения, собрать их обратно получатель может только по длине
+        return _paramLengthPrefix || laneRecordsWanted();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Protocol::fail(auto&& err)
     {
@@ -676,22 +1276,56 @@ namespace dci::module::stiac
             _pumpingInProgress = false;
         }};
 
-        while(apip::State::work == _state && _hasOutputFlags)
+        for(;;)
         {
+            while(apip::State::work == _state && _hasOutputFlags)
+            {
+
+                //сначала дальние по цепи: выход уходит вниз по течению прежде чем ближние выдадут следующую
+                //порцию, так крупное сообщение проходит цепь по частям и не копится целиком на каждом звене
+                std::size_t index = static_cast<std::size_t>(63 - std::countl_zero(_hasOutputFlags));
+                _hasOutputFlags ^= (1ull << index);
+
+                dbgAssert(index < _chain.size());
 
-            std::size_t index = utils::bits::count0Least(_hasOutputFlags);
-            _hasOutputFlags ^= (1ull << index);
+                const bool tail = index == _chain.size()-1;
+                if(tail && (_chain[index] != _outCiphering.get() || _outCiphering->outputEager()))
+                {
+                    _remoteOutputEager = true;
+                }
 
-            dbgAssert(index < _chain.size());
+                Bytes data = _chain[index]->flushOutput();
+                if(data.empty())
+                {
+                    continue;
+                }
+
+                if(tail)
+                {
+                    _chain[0]->input(std::move(data));
+                }
+                else
+                {
+                    _chain[index+1]->input(std::move(data));
+                }
+            }
 
-            if(index == _chain.size()-1)
+            //служебное рукопожатия и полезная нагрузка прохода уходят пользователю одной выдачей;
+            //выдача может принести новый вход - тогда еще проход
+            if(!_remoteEdge || !_remoteEdge->hasPendingOutput())
             {
-                _chain[0]->input(_chain[index]->flushOutput());
+                break;
             }
-            else
+
+            //одни подтверждения смены ключа ждут попутной выдачи, но не дольше текущего такта
+            if(!_remoteOutputEager)
             {
-                _chain[index+1]->input(_chain[index]->flushOutput());
+                _lazyOutputTicker.start();
+                break;
             }
+
+            _remoteOutputEager = false;
+            _remoteEdge->flushPendingOutput();
         }
 
         return;
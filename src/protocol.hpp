@@ -43,6 +43,8 @@ namespace dci::module::stiac
         std::vector<uint8> protocolMarker();
         void handshakeProtocolMarker(std::vector<uint8> remote);
         void handshakeAuthentificated();
+        void handshakeResumptionTicket(apip::ResumptionTicket&& ticket);
+        void outputKeyChanged();
         void handshakeFail(const std::string& details);
         void decipheringFail(const std::string& details);
 
@@ -53,6 +55,10 @@ namespace dci::module::stiac
     private:
         void paramsChanged(uint32 epc);
         bool buildChain();
+        static bool secured(apip::Requirements requirements);
+        static bool authenticationOnly(apip::Requirements requirements);
+        bool laneRecordsWanted() const;
+        bool lengthPrefixWanted() const;
 
         void fail(auto&& err);
         void pause();
@@ -74,6 +80,20 @@ namespace dci::module::stiac
             uint8 _outputRequirements   = 0;
         };
 
+        //начиная с версии 1 за маркером идут опции [tag][size][value...], неизвестные пропускаются
+
+        enum MarkerOption : uint8
+        {
+            mo_aeads = 0,
+            mo_maxFrameSize = 1,//uint32 предел тела входящего кадра
+            mo_ratchet = 2,//без значения, принимается смена ключа храповиком
+            mo_compactIds = 3,//без значения, идентификаторы звеньев в исходящих сообщениях сжатые
+            mo_tuidTable = 4,//uint32 версия заранее известной таблицы tuid
+            mo_dedup = 5,//uint32 объем кеша для входящих дедуплицированных сообщений
+            mo_laneRecords = 6,//без значения, поток LocalEdge записями полос (если объявили обе стороны)
+            mo_lengthPrefix = 7,//без значения, сообщения LocalEdge с длиной впереди (если объявили обе стороны)
+        };
+
     private://задиктованные пользователем параметры
         api::RemoteEdge<>::Opposite     _paramRemoteEdge;
 
@@ -83,11 +103,38 @@ namespace dci::module::stiac
 
         Bytes                           _paramAuthPrologue;
         apip::PrivateKey                _paramAuthLocal {};
+        apip::PublicKey                 _paramAuthRemote {};
+        bool                            _paramEarlyPayload = false;
+        uint32                          _paramResumptionLifetime = 0;
+        apip::ResumptionTicket          _paramResumptionTicket {};
+        apip::Aead                      _paramAeads = apip::Aead::chacha20poly1305;
+        uint32                          _paramMaxFrameSize = crypto::Handshake::_shortFrameSize;
+        uint32                          _paramRekeyMessages = 0;
+        uint64                          _paramRekeyBytes = 0;
+        uint32                          _paramRekeySeconds = 0;
+        uint32                          _paramRatchet = 0;
+        bool                            _paramHandshakeOffload = false;
+        bool                            _paramKeyPool = true;
+        apip::Checksum                  _paramChecksum = apip::Checksum::crc64;
+        uint32                          _paramMaxChunkSize = 0;
 
         api::LocalEdge<>::Opposite      _paramLocalEdge;
 
         apip::AutoPumping               _paramAutoPumping = apip::AutoPumping::instantly;
 
+        uint32                          _paramDedupThreshold = 0;
+        uint32                          _paramDedupCacheSize = 0;
+
+        bool                            _paramBatchCiphering = false;
+
+        uint32                          _paramAbortThreshold = 0;
+        bool                            _paramPriorityLanes = false;
+        bool                            _paramLengthPrefix = false;
+        bool                            _paramCompactIds = false;
+        uint32                          _paramTuidVersion = 0;
+        apip::TuidTable                 _paramTuidTable;
+        localEdge::TuidSeedPtr          _paramTuidSeed;
+
     private:
         apip::Requirements              _effectiveInputRequirements     = apip::Requirements::null;
         apip::Requirements              _effectiveOutputRequirements    = apip::Requirements::null;
@@ -105,6 +152,19 @@ namespace dci::module::stiac
             epc_authPrologue                = uint32(1) << 4,
             epc_authLocal                   = uint32(1) << 5,
             epc_localEdge                   = uint32(1) << 6,
+            epc_aeads                       = uint32(1) << 7,
+            epc_maxFrameSize                = uint32(1) << 8,
+            epc_checksum                    = uint32(1) << 9,
+            epc_ratchet                     = uint32(1) << 10,
+            epc_authRemote                  = uint32(1) << 11,
+            epc_resumptionTicket            = uint32(1) << 12,
+            epc_compactIds                  = uint32(1) << 13,
+            epc_tuidTable                   = uint32(1) << 14,
+            epc_dedup                       = uint32(1) << 15,
+            epc_laneRecords                 = uint32(1) << 16,
+            epc_maxChunkSize                = uint32(1) << 17,
+            epc_earlyPayload                = uint32(1) << 18,
+            epc_lengthPrefix                = uint32(1) << 19,
         };
 
         uint32 _paramsChanging = ~uint32();
@@ -134,6 +194,10 @@ namespace dci::module::stiac
         bool                        _pumpingInProgress = false;
         poll::Timer                 _delayedAutoPumpTicker{std::chrono::milliseconds{0}, false, [this]{doPump();}};
 
+        //накопленное для remoteEdge содержит не только подтверждения смены ключа
+        bool                        _remoteOutputEager = false;
+        poll::Timer                 _lazyOutputTicker{std::chrono::milliseconds{0}, false, [this]{_remoteOutputEager = true; doPump();}};
+
         crypto::HandshakePtr        _handshake;
 
         std::queue<cmt::Promise<apip::PublicKey>> _remoteAuthWaiters;
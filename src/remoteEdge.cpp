@@ -36,10 +36,29 @@ namespace dci::module::stiac
         sbs::Owner::flush();
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool RemoteEdge::hasPendingOutput() const
+    {
+        return !_pending.empty();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void RemoteEdge::flushPendingOutput()
+    {
+        //выдача может повторно войти в протокол, состояние до нее
+        Bytes data = std::move(_pending);
+        _interface->output(std::move(data));
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void RemoteEdge::input(Bytes&& msg)
     {
-        //цепь -> пользователь
-        _interface->output(std::move(msg));
+        //цепь -> пользователь, служебные кадры рукопожатия и смены ключа копятся вместе с полезной нагрузкой
+        _pending.end().write(std::move(msg));
+
+        if(_pending.size() >= _pendingLimit)
+        {
+            flushPendingOutput();
+        }
     }
 }
@@ -20,11 +20,19 @@ namespace dci::module::stiac
         RemoteEdge(Protocol* protocol, const api::RemoteEdge<>::Opposite& interface);
         ~RemoteEdge() override;
 
+        //накопленное за проход прокачки - пользователю одной выдачей
+        bool hasPendingOutput() const;
+        void flushPendingOutput();
+
     private:
         void input(Bytes&& msg) override;
 
     private:
+        //крупное уходит не дожидаясь конца прохода, чтобы не копить сообщение целиком
+        static constexpr uint32 _pendingLimit = 1024*64;
+
         api::RemoteEdge<>::Opposite _interface;
+        Bytes                       _pending;
     };
 
     using RemoteEdgePtr = std::unique_ptr<RemoteEdge>;
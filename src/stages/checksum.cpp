@@ -0,0 +1,312 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "checksum.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#   include <immintrin.h>
+#   define CHECKSUM_HW 1
+#   define CHECKSUM_CLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#   define CHECKSUM_CRC32_TARGET __attribute__((target("sse4.2")))
+#else
+#   define CHECKSUM_HW 0
+#   define CHECKSUM_CLMUL_TARGET
+#   define CHECKSUM_CRC32_TARGET
+#endif
+
+namespace dci::module::stiac::stages
+{
+    namespace
+    {
+        std::atomic<bool> accelerationAllowed {true};
+
+        //crc-64-jones, нормальная форма без старшего члена
+        constexpr uint64 crc64Poly = 0xad93d23594c935a9;
+
+        //crc32c, отраженная форма
+        constexpr uint32 crc32cPolyReflected = 0x82f63b78;
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        constexpr uint64 reflect64(uint64 v)
+        {
+            uint64 res = 0;
+            for(uint32 i(0); i<64; ++i)
+            {
+                res = (res << 1) | ((v >> i) & 1);
+            }
+            return res;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //x^n mod P, нормальная форма
+        constexpr uint64 xPowMod(uint32 n)
+        {
+            uint64 res = 1;
+            for(uint32 i(0); i<n; ++i)
+            {
+                bool carry = res >> 63;
+                res <<= 1;
+                if(carry)
+                {
+                    res ^= crc64Poly;
+                }
+            }
+            return res;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //множитель для свертки 64-битной половины на exponent бит вперед. Произведение
+        //отраженных clmul сдвинуто на один разряд, это учитывается понижением степени
+        constexpr uint64 foldConstant(uint32 exponent)
+        {
+            return reflect64(xPowMod(exponent - 1));
+        }
+
+        constexpr std::array<uint64, 256> crc64Table = []
+        {
+            constexpr uint64 polyReflected = reflect64(crc64Poly);
+
+            std::array<uint64, 256> res {};
+            for(uint32 b(0); b<256; ++b)
+            {
+                uint64 v = b;
+                for(uint32 k(0); k<8; ++k)
+                {
+                    v = (v & 1) ? (v >> 1) ^ polyReflected : (v >> 1);
+                }
+                res[b] = v;
+            }
+            return res;
+        }();
+
+        constexpr std::array<uint32, 256> crc32cTable = []
+        {
+            std::array<uint32, 256> res {};
+            for(uint32 b(0); b<256; ++b)
+            {
+                uint32 v = b;
+                for(uint32 k(0); k<8; ++k)
+                {
+                    v = (v & 1) ? (v >> 1) ^ crc32cPolyReflected : (v >> 1);
+                }
+                res[b] = v;
+            }
+            return res;
+        }();
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        uint64 crc64Bytewise(uint64 crc, const uint8* data, std::size_t size)
+        {
+            for(std::size_t i(0); i<size; ++i)
+            {
+                crc = crc64Table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        uint32 crc32cBytewise(uint32 crc, const uint8* data, std::size_t size)
+        {
+            for(std::size_t i(0); i<size; ++i)
+            {
+                crc = crc32cTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+#if CHECKSUM_HW
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHECKSUM_CLMUL_TARGET inline __m128i fold(__m128i v, __m128i k)
+        {
+            return _mm_xor_si128(
+                        _mm_clmulepi64_si128(v, k, 0x00),
+                        _mm_clmulepi64_si128(v, k, 0x11));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHECKSUM_CLMUL_TARGET inline __m128i load(const uint8* p)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHECKSUM_CLMUL_TARGET uint64 crc64Clmul(uint64 crc, const uint8* data, std::size_t size)
+        {
+            //младшая половина регистра - старшие степени, сворачивается на 64 бита дальше старшей
+            const __m128i k128 = _mm_set_epi64x(
+                                     static_cast<int64>(foldConstant(128)),
+                                     static_cast<int64>(foldConstant(128+64)));
+            const __m128i k512 = _mm_set_epi64x(
+                                     static_cast<int64>(foldConstant(512)),
+                                     static_cast<int64>(foldConstant(512+64)));
+
+            //текущее значение - поправка к первым 64 битам потока
+            __m128i x0 = _mm_xor_si128(load(data), _mm_set_epi64x(0, static_cast<int64>(crc)));
+            __m128i x1 = load(data+16);
+            __m128i x2 = load(data+32);
+            __m128i x3 = load(data+48);
+            data += 64;
+            size -= 64;
+
+            while(size >= 64)
+            {
+                x0 = _mm_xor_si128(fold(x0, k512), load(data));
+                x1 = _mm_xor_si128(fold(x1, k512), load(data+16));
+                x2 = _mm_xor_si128(fold(x2, k512), load(data+32));
+                x3 = _mm_xor_si128(fold(x3, k512), load(data+48));
+                data += 64;
+                size -= 64;
+            }
+
+            x1 = _mm_xor_si128(fold(x0, k128), x1);
+            x2 = _mm_xor_si128(fold(x1, k128), x2);
+            x3 = _mm_xor_si128(fold(x2, k128), x3);
+
+            while(size >= 16)
+            {
+                x3 = _mm_xor_si128(fold(x3, k128), load(data));
+                data += 16;
+                size -= 16;
+            }
+
+            //остаток 128 бит сравним по модулю с сообщением, его crc с нуля и есть текущее значение
+            alignas(16) uint8 rest[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(rest), x3);
+            crc = crc64Bytewise(0, rest, sizeof(rest));
+
+            return crc64Bytewise(crc, data, size);
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        CHECKSUM_CRC32_TARGET uint32 crc32cHw(uint32 crc, const uint8* data, std::size_t size)
+        {
+            uint64 v = crc;
+            while(size >= 8)
+            {
+                uint64 word;
+                std::memcpy(&word, data, sizeof(word));
+                v = _mm_crc32_u64(v, word);
+                data += 8;
+                size -= 8;
+            }
+
+            crc = static_cast<uint32>(v);
+            while(size)
+            {
+                crc = _mm_crc32_u8(crc, *data);
+                ++data;
+                --size;
+            }
+
+            return crc;
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Checksum::Checksum(Kind kind)
+        : _kind(kind)
+    {
+        reset();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Checksum::Kind Checksum::kind() const
+    {
+        return _kind;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Checksum::size() const
+    {
+        return Kind::crc64 == _kind ? sizeof(uint64) : sizeof(uint32);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Checksum::reset()
+    {
+        _state = Kind::crc64 == _kind ? 0 : 0xffffffff;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Checksum::process(const void* data, uint32 size)
+    {
+        if(Kind::crc64 == _kind)
+        {
+            _state = crc64(_state, data, size);
+        }
+        else
+        {
+            _state = crc32c(static_cast<uint32>(_state), data, size);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Checksum::value() const
+    {
+        return Kind::crc64 == _kind ? _state : (_state ^ 0xffffffff);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Checksum::crc64(uint64 crc, const void* data, std::size_t size)
+    {
+        const uint8* bytes = static_cast<const uint8*>(data);
+
+#if CHECKSUM_HW
+        if(size >= 64 && crc64Accelerated())
+        {
+            return crc64Clmul(crc, bytes, size);
+        }
+#endif
+
+        return crc64Bytewise(crc, bytes, size);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 Checksum::crc32c(uint32 crc, const void* data, std::size_t size)
+    {
+        const uint8* bytes = static_cast<const uint8*>(data);
+
+#if CHECKSUM_HW
+        if(crc32cAccelerated())
+        {
+            return crc32cHw(crc, bytes, size);
+        }
+#endif
+
+        return crc32cBytewise(crc, bytes, size);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Checksum::crc64Accelerated()
+    {
+#if CHECKSUM_HW
+        static const bool res = __builtin_cpu_supports("pclmul");
+        return res && accelerationAllowed.load(std::memory_order_relaxed);
+#else
+        return false;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Checksum::crc32cAccelerated()
+    {
+#if CHECKSUM_HW
+        static const bool res = __builtin_cpu_supports("sse4.2");
+        return res && accelerationAllowed.load(std::memory_order_relaxed);
+#else
+        return false;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Checksum::setAccelerated(bool enable)
+    {
+        accelerationAllowed.store(enable, std::memory_order_relaxed);
+    }
+}
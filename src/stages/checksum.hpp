@@ -0,0 +1,57 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "pch.hpp"
+
+namespace dci::module::stiac::stages
+{
+    /* Контрольные суммы кусков в режиме целостности.
+     *
+     * crc64 - crc-64-jones, прежний формат бит в бит. При наличии PCLMULQDQ поток сворачивается
+     * по 128 бит (четыре полосы по 512), иначе табличный расчет по байту.
+     *
+     * crc32c - Castagnoli, вдвое короче в потоке. При наличии SSE4.2 считается инструкцией crc32
+     * по 8 байт, иначе таблично.
+     *
+     * Выбор не согласуется, обе стороны должны быть настроены одинаково.
+     */
+    class Checksum
+    {
+    public:
+        enum class Kind : uint8
+        {
+            crc64   = 0,
+            crc32c  = 1,
+        };
+
+    public:
+        Checksum(Kind kind = Kind::crc64);
+
+        Kind kind() const;
+        uint32 size() const;
+
+        void reset();
+        void process(const void* data, uint32 size);
+        uint64 value() const;
+
+        static uint64 crc64(uint64 crc, const void* data, std::size_t size);
+        static uint32 crc32c(uint32 crc, const void* data, std::size_t size);
+
+        static bool crc64Accelerated();
+        static bool crc32cAccelerated();
+
+        //для проверок: выключенное ускорение оставляет только табличные пути, на весь процесс
+        static void setAccelerated(bool enable);
+
+    private:
+        Kind    _kind;
+        uint64  _state = 0;
+    };
+}
@@ -10,6 +10,18 @@
 
 namespace dci::module::stiac::stages::in
 {
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::setMaxFrameSize(uint32 size)
+    {
+        _maxFrameSize = std::clamp(size, _shortFrameSize, _longFrameSizeLimit);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::setStreaming(bool enable)
+    {
+        _streaming = enable;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Ciphering::input(Bytes&& data)
     {
@@ -19,7 +31,7 @@ namespace dci::module::stiac::stages::in
             return;
         }
 
-        if(!_keySetted)
+        if(!_keySetted && !keyDeferred())
         {
             bytes::Alter a(data.begin());
             _hs->inputComing(MessageType::fakeNull, a);
@@ -33,13 +45,44 @@ namespace dci::module::stiac::stages::in
         dbgAssert(!data.empty());
 
         _input.end().write(std::move(data));
+        updateBufferedPeak();
+
+        process();
+        updateBufferedPeak();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Ciphering::bufferedPeak() const
+    {
+        return _bufferedPeak;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::updateBufferedPeak()
+    {
+        _bufferedPeak = std::max(_bufferedPeak, uint64(_input.size()) + _body.size() + _payload.size() + _earlyPayload.size());
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::keySettled()
+    {
+        //ключ из пула DH пришел, продолжить накопленное
+        if(State::bad != _state && !_input.empty())
+        {
+            process();
+        }
+    }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::process()
+    {
         for(;;)
         {
             switch(_state)
             {
             case State::awaitType:
-                if(!readType()) return;
+                //следующий кадр может быть уже на новом ключе
+                if(keyDeferred() || !readType()) return;
                 break;
 
             case State::awaitSize:
@@ -50,6 +93,10 @@ namespace dci::module::stiac::stages::in
                 if(!readPayload()) return;
                 break;
 
+            case State::awaitMac:
+                if(!readMac()) return;
+                break;
+
             case State::bad:
                 return;
             }
@@ -83,6 +130,8 @@ namespace dci::module::stiac::stages::in
         {
         case MessageType::payloadChunk:
         case MessageType::payloadLastChunk:
+        case MessageType::payloadLongChunk:
+        case MessageType::payloadLongLastChunk:
             _messageMix2Hash = false;
             break;
 
@@ -97,6 +146,8 @@ namespace dci::module::stiac::stages::in
         {
         case MessageType::payloadChunk:
         case MessageType::payloadLastChunk:
+        case MessageType::payloadLongChunk:
+        case MessageType::payloadLongLastChunk:
         case MessageType::protocolMarker:
             _state = State::awaitSize;
             break;
@@ -108,10 +159,21 @@ namespace dci::module::stiac::stages::in
             break;
 
         case MessageType::keyApplied:
+        case MessageType::ratchet:
             _messageSize = 0;
             _state = State::awaitPayload;
             break;
 
+        case MessageType::aead:
+            _messageSize = 1;
+            _state = State::awaitPayload;
+            break;
+
+        case MessageType::ticket:
+            _messageSize = crypto::Handshake::_ticketMessageSize;
+            _state = State::awaitPayload;
+            break;
+
         default:
             _state = State::bad;
             _protocol->decipheringFail("bad data from remote");
@@ -124,29 +186,49 @@ namespace dci::module::stiac::stages::in
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Ciphering::readSize()
     {
-        if(_input.size() < _payloadHeaderSize)
+        const bool longFrame =
+                MessageType::payloadLongChunk == _messageType ||
+                MessageType::payloadLongLastChunk == _messageType;
+
+        const uint32 headerSize = longFrame ? _longPayloadHeaderSize : _payloadHeaderSize;
+
+        if(_input.size() < headerSize)
         {
             //не хватает данных, ждем
             return false;
         }
 
         static_assert(2 == _payloadHeaderSize);
-        std::array<uint8, _payloadHeaderSize> payloadHeader;
+        static_assert(4 == _longPayloadHeaderSize);
+        std::array<uint8, _longPayloadHeaderSize> payloadHeader {};
 
-        dbgAssert(_input.size() >= _payloadHeaderSize);
-        uint32 removed = _input.begin().removeTo(payloadHeader.data(), payloadHeader.size());
-        dbgAssert(removed == _payloadHeaderSize);
+        dbgAssert(_input.size() >= headerSize);
+        uint32 removed = _input.begin().removeTo(payloadHeader.data(), headerSize);
+        dbgAssert(removed == headerSize);
         (void)removed;
 
         if(_messageMix2Hash)
         {
-            mixHashUpdate(payloadHeader.data(), payloadHeader.size());
+            mixHashUpdate(payloadHeader.data(), headerSize);
         }
 
-        messageDecipher(payloadHeader.data(), payloadHeader.size());
+        messageDecipher(payloadHeader.data(), headerSize);
 
         _messageSize = static_cast<uint32>(payloadHeader[0] | (payloadHeader[1]<<8));
 
+        if(longFrame)
+        {
+            _messageSize |= static_cast<uint32>(payloadHeader[2]<<16) | (static_cast<uint32>(payloadHeader[3])<<24);
+
+            //больше объявленного не буферизуем
+            if(_messageSize > _maxFrameSize)
+            {
+                _state = State::bad;
+                _protocol->decipheringFail("remote frame exceeds negotiated size");
+                return true;
+            }
+        }
+
         _state = State::awaitPayload;
         return true;
     }
@@ -154,41 +236,56 @@ namespace dci::module::stiac::stages::in
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Ciphering::readPayload()
     {
-        if(_input.size() < _messageSize + _macSize)
+        dbgAssert(_body.size() <= _messageSize);
+        uint32 rest = _messageSize - _body.size();
+        uint32 available = std::min(rest, _input.size());
+
+        if(available < rest && available < _bodyRunSize)
         {
-            //не хватает данных тела и контрольной суммы, ждем
+            //копить до прогона приемлемого размера или до конца тела
             return false;
         }
 
-        Bytes chunk;
-        bytes::Alter src(_input.begin());
+        if(available)
+        {
+            Bytes part;
+            _input.begin().removeTo(part, available);
+            dbgAssert(part.size() == available);
 
-        //вычитать шифрованное тело
-        src.removeTo(chunk, _messageSize);
-        dbgAssert(chunk.size() == _messageSize);
+            //расшифровка на месте, в тех же сегментах в которых пришло
+            part = compacted(std::move(part));
+            messageDecipher(part, _messageMix2Hash);
+
+            _body.end().write(std::move(part));
+        }
 
-        //расшифровка тела
+        if(_body.size() < _messageSize)
         {
-            bytes::Alter c(chunk.begin());
-            while(!c.atEnd())
-            {
-                if(_messageMix2Hash)
-                {
-                    mixHashUpdate(c.continuousData4Write(), c.continuousDataSize());
-                }
+            return false;
+        }
 
-                messageDecipher(c.continuousData4Write(), c.continuousDataSize());
-                c.advanceChunks(1);
-            }
+        _state = State::awaitMac;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Ciphering::readMac()
+    {
+        if(_input.size() < _macSize)
+        {
+            //не хватает контрольной суммы, ждем
+            return false;
         }
 
         //валидация
         uint8 macIn[_macSize];
-        src.removeTo(macIn, _macSize);
+        _input.begin().removeTo(macIn, _macSize);
 
         if(!messageDecipherFinish(macIn))
         {
             _state = State::bad;
+            crypto::cleanMemoryUnder(_body);
+            _body.clear();
             _protocol->integrityViolation(this);
             return true;
         }
@@ -201,7 +298,15 @@ namespace dci::module::stiac::stages::in
 
         _hs->someInputMessageDeciphered();
 
+        //кадр на ключе с эфемерным ключом удаленной стороны: она жива и придержанное не повтор
+        bool payloadAllowed = _hs->inputPayloadAllowed();
+        if(payloadAllowed && !_earlyPayload.empty())
+        {
+            accumulateOutput(std::move(_earlyPayload));
+        }
+
         MessageType messageType = _messageType;
+        Bytes chunk = std::move(_body);
 
         _state = State::awaitType;
         _messageType = MessageType::fakeNull;
@@ -211,14 +316,24 @@ namespace dci::module::stiac::stages::in
         switch(messageType)
         {
         case MessageType::payloadChunk:
+        case MessageType::payloadLongChunk:
+            _payloadSize += chunk.size();
             _payload.end().write(std::move(chunk));
+
+            if(_streaming)
+            {
+                //кадр аутентифицирован, дальше по цепи сразу, не дожидаясь конца сообщения
+                passPayload(std::move(_payload), payloadAllowed);
+            }
             break;
 
         case MessageType::payloadLastChunk:
+        case MessageType::payloadLongLastChunk:
             {
+                uint64 trafficSize = _payloadSize + chunk.size();
+                _payloadSize = 0;
                 _payload.end().write(std::move(chunk));
-                uint32 trafficSize = _payload.size();
-                accumulateOutput(std::move(_payload));
+                passPayload(std::move(_payload), payloadAllowed);
                 _hs->inputTraffic(trafficSize);
             }
             break;
@@ -226,6 +341,8 @@ namespace dci::module::stiac::stages::in
         case MessageType::protocolMarker:
         case MessageType::ekey:
         case MessageType::skey:
+        case MessageType::aead:
+        case MessageType::ticket:
             {
                 bytes::Alter a(chunk.begin());
                 _hs->inputComing(messageType, a);
@@ -234,6 +351,7 @@ namespace dci::module::stiac::stages::in
             break;
 
         case MessageType::keyApplied:
+        case MessageType::ratchet:
             {
                 bytes::Alter fakeAlter;
                 _hs->inputComing(messageType, fakeAlter);
@@ -248,4 +366,53 @@ namespace dci::module::stiac::stages::in
 
         return true;
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::passPayload(Bytes&& data, bool allowed)
+    {
+        if(!allowed)
+        {
+            //первый пакет режима известного ключа без setEarlyPayload: записанный злоумышленником
+            //повтор дальше не пройдет, кадра на ключе с эфемерным ключом удаленной стороны ему не сделать
+            _earlyPayload.end().write(std::move(data));
+            return;
+        }
+
+        accumulateOutput(std::move(data));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Ciphering::compacted(Bytes&& part)
+    {
+        //сколько сегментов
+        uint32 segments = 0;
+        {
+            bytes::Cursor c(part.begin());
+            while(!c.atEnd())
+            {
+                segments++;
+                c.advanceChunks(1);
+            }
+        }
+
+        //крупные сегменты расшифровываются на месте без копий. Мелкие все равно пойдут
+        //через сборку (копия туда и обратно), одна копия в плотный буфер дешевле и дает
+        //крупные сегменты дальше по цепи
+        if(segments < 2 || part.size() >= segments * _smallSegmentSize)
+        {
+            return std::move(part);
+        }
+
+        Bytes res;
+        bytes::Alter dst(res.end());
+
+        bytes::Cursor c(part.begin());
+        while(!c.atEnd())
+        {
+            dst.write(c.continuousData(), c.continuousDataSize());
+            c.advanceChunks(1);
+        }
+
+        return res;
+    }
 }
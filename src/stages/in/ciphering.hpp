@@ -20,13 +20,28 @@ namespace dci::module::stiac::stages::in
     public:
         using Base::Base;
 
+        //предел тела входящего кадра, объявляемый удаленной стороне
+        void setMaxFrameSize(uint32 size);
+
+        //сообщения удаленной стороны с длиной впереди: кадр уходит дальше сразу, иначе сообщение собирается целиком
+        void setStreaming(bool enable);
+
     private:
         void input(Bytes&& data) override;
+        void keySettled() override;
+        void process();
+
+        uint64 bufferedPeak() const;
 
     private:
         bool readType();
         bool readSize();
         bool readPayload();
+        bool readMac();
+
+        void passPayload(Bytes&& data, bool allowed);
+        Bytes compacted(Bytes&& part);
+        void updateBufferedPeak();
 
     private:
         Bytes       _input;
@@ -36,6 +51,7 @@ namespace dci::module::stiac::stages::in
             awaitType,
             awaitSize,
             awaitPayload,
+            awaitMac,
             bad,
         } _state {State::awaitType};
 
@@ -43,7 +59,20 @@ namespace dci::module::stiac::stages::in
         uint32      _messageSize = 0;
         bool        _messageMix2Hash = false;
 
-        Bytes       _payload;
+        //тело текущего кадра, расшифровывается на месте по мере поступления
+        Bytes       _body;
+
+        //расшифровывать прогонами не мельче этого, если кадр еще не пришел целиком
+        static constexpr uint32 _bodyRunSize = _stagingSize;
+
+        uint32      _maxFrameSize = _shortFrameSize;
+
+        bool        _streaming = false;
+        Bytes       _payload;//собираемое сообщение без длины впереди
+        Bytes       _earlyPayload;//принятое до подтверждения что удаленная сторона жива
+        uint64      _payloadSize = 0;//принятое из текущего сообщения, отдаваемое по кадрам может превышать 4Гб
+
+        uint64      _bufferedPeak = 0;//принятое и еще не отданное дальше
     };
 
     using CipheringPtr = std::unique_ptr<Ciphering>;
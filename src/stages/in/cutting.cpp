@@ -17,80 +17,175 @@ namespace dci::module::stiac::stages::in
     {
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Cutting::setChecksum(Checksum::Kind kind)
+    {
+        _checksum = Checksum(kind);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Cutting::setMaxChunkSize(uint32 size)
+    {
+        //классический заголовок держит длину до 32767, все что выше - только varint
+        _maxChunkSize = size >= _classicChunkSize ? size : 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Cutting::setStreaming(bool enable)
+    {
+        _streaming = enable;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Cutting::input(Bytes&& msg)
     {
+        if(_bad)
+        {
+            return;
+        }
+
         _input.end().write(std::move(msg));
 
-        const uint16 checksumSize = _doIntegrityChecking ? (8) : 0;
+        const uint32 checksumSize = _doIntegrityChecking ? _checksum.size() : 0;
 
         for(;;)
         {
-            if(!_chunkSize)
+            if(!_chunkStarted)
             {
-                const uint16 minChunkSize =
-                        2               // заголовок
-                        +checksumSize;  // контрольная сумма
-
-                if(_input.size() < minChunkSize)
+                if(!readHeader())
                 {
-                    //не хватает данных заголовка
                     return;
                 }
 
-                //вычитать заголовок и переработать его
-                uint16 header;
-                _input.begin().removeTo(&header, 2);
-                header = stiac::serialization::fixEndian(header);
+                _chunkStarted = true;
+                _checksum.reset();
+            }
 
-                _chunkSize = header & 0x7fff;
-                _chunkFinal = header & 0x8000 ? true : false;
+            //тело забирается по мере поступления, сумма считается пока пришедшее еще в кеше
+            if(_body.size() < _chunkSize && !_input.empty())
+            {
+                Bytes part;
+                _input.begin().removeTo(part, std::min(_chunkSize - _body.size(), _input.size()));
+
+                if(_doIntegrityChecking)
+                {
+                    bytes::Cursor c(part.begin());
+                    while(!c.atEnd())
+                    {
+                        _checksum.process(c.continuousData(), c.continuousDataSize());
+                        c.advanceChunks(1);
+                    }
+                }
+
+                _body.end().write(std::move(part));
             }
 
-            if(_input.size() < _chunkSize + checksumSize)
+            if(_body.size() < _chunkSize || _input.size() < checksumSize)
             {
                 //не хватает данных тела и контрольной суммы
                 return;
             }
 
-            Bytes chunk;
-            bytes::Alter src(_input.begin());
-
-            //вычитать тело и контрольную сумму
-            src.removeTo(chunk, _chunkSize);
-            dbgAssert(chunk.size() == _chunkSize);
-
-            //пересчитать контрольную сумму и провалидировать
+            //провалидировать
             if(_doIntegrityChecking)
             {
                 uint64 checksum;
-                src.removeTo(&checksum, 8);
-                checksum = stiac::serialization::fixEndian(checksum);
-
-                bytes::Cursor c(chunk.begin());
-                Crc crc;
-                while(!c.atEnd())
+                if(sizeof(uint64) == checksumSize)
+                {
+                    _input.begin().removeTo(&checksum, sizeof(checksum));
+                    checksum = stiac::serialization::fixEndian(checksum);
+                }
+                else
                 {
-                    crc.process_bytes(c.continuousData(), c.continuousDataSize());
-                    c.advanceChunks(1);
+                    uint32 checksum32;
+                    _input.begin().removeTo(&checksum32, sizeof(checksum32));
+                    checksum = stiac::serialization::fixEndian(checksum32);
                 }
 
-                if(crc.checksum() != checksum)
+                if(_checksum.value() != checksum)
                 {
+                    //испорченное дальше не идет
+                    _bad = true;
+                    _body.clear();
+                    _message.clear();
+                    _input.clear();
                     _protocol->integrityViolation(this);
+                    return;
                 }
             }
 
-            //накапливать куски в цельное сообщение
-            _message.end().write(std::move(chunk));
+            //куски проверены по отдельности, с длиной впереди отдавать сразу не дожидаясь финального
+            _message.end().write(std::move(_body));
 
-            if(_chunkFinal)
+            if((_streaming || _chunkFinal) && !_message.empty())
             {
                 Base::input(std::move(_message));
             }
 
+            _chunkStarted = false;
             _chunkSize = 0;
             _chunkFinal = false;
         }
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Cutting::readHeader()
+    {
+        if(!_maxChunkSize)
+        {
+            if(_input.size() < 2)
+            {
+                //не хватает данных заголовка
+                return false;
+            }
+
+            //вычитать заголовок и переработать его
+            uint16 header;
+            _input.begin().removeTo(&header, 2);
+            header = stiac::serialization::fixEndian(header);
+
+            _chunkSize = header & 0x7fff;
+            _chunkFinal = header & 0x8000 ? true : false;
+            return true;
+        }
+
+        std::array<uint8, _maxHeaderSize> header;
+        uint32 available = std::min(_maxHeaderSize, _input.size());
+        _input.begin().read(header.data(), available);
+
+        uint64 v = 0;
+        for(uint32 i(0); i<available; ++i)
+        {
+            v |= uint64(header[i] & 0x7f) << (7*i);
+
+            if(header[i] & 0x80)
+            {
+                continue;
+            }
+
+            if((v >> 1) > _maxChunkSize)
+            {
+                //больше объявленного не буферизуем
+                _bad = true;
+                _input.clear();
+                _protocol->integrityViolation(this);
+                return false;
+            }
+
+            _input.begin().remove(i+1);
+            _chunkSize = static_cast<uint32>(v >> 1);
+            _chunkFinal = v & 1;
+            return true;
+        }
+
+        if(available == _maxHeaderSize)
+        {
+            _bad = true;
+            _input.clear();
+            _protocol->integrityViolation(this);
+        }
+
+        //не хватает данных заголовка
+        return false;
+    }
 }
@@ -9,6 +9,7 @@
 
 #include "pch.hpp"
 #include "../base.hpp"
+#include "../checksum.hpp"
 
 namespace dci::module::stiac::stages::in
 {
@@ -21,19 +22,36 @@ namespace dci::module::stiac::stages::in
     public:
         Cutting(Protocol* protocol, bool doIntegrityChecking);
 
+        void setChecksum(Checksum::Kind kind);
+        void setMaxChunkSize(uint32 size);
+
+        //сообщения с длиной впереди: кусок уходит дальше сразу, иначе сообщение собирается до финального
+        void setStreaming(bool enable);
+
     private:
         void input(Bytes&& msg) override;
 
     private:
         bool _doIntegrityChecking = true;
+        Checksum _checksum;
 
-        using Crc = boost::crc_optimal<64, 0xad93d23594c935a9, 0, 0, true, true>;
+        static constexpr uint32 _classicChunkSize = 0x8000;
+        static constexpr uint32 _maxHeaderSize = 5;
+        uint32 _maxChunkSize = 0;//0 - классический заголовок
+
+        bool readHeader();
 
     private:
         Bytes   _input;
+        bool    _chunkStarted = false;
         uint32  _chunkSize = 0;
         bool    _chunkFinal = false;
+        bool    _bad = false;
+        bool    _streaming = false;
         Bytes   _message;
+
+        //принятая часть тела текущего куска, сумма по ней уже посчитана
+        Bytes   _body;
     };
 
     using CuttingPtr = std::unique_ptr<Cutting>;
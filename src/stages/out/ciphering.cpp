@@ -10,9 +10,26 @@
 
 namespace dci::module::stiac::stages::out
 {
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Ciphering::~Ciphering()
+    {
+        if(_batch)
+        {
+            _batch->cancel(this);
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Ciphering::urgent(MessageType mt, const void* data, uint32 dataSize)
     {
+        //служебное уходит после уже поставленных в пачку кадров
+        flushBatch();
+
+        if(MessageType::keyApplied != mt)
+        {
+            _outputEager = true;
+        }
+
         switch(mt)
         {
         case MessageType::fakeNull:
@@ -48,6 +65,9 @@ namespace dci::module::stiac::stages::out
         case MessageType::ekey:
         case MessageType::skey:
         case MessageType::keyApplied:
+        case MessageType::aead:
+        case MessageType::ratchet:
+        case MessageType::ticket:
             {
                 Bytes msg;
                 {
@@ -80,11 +100,94 @@ namespace dci::module::stiac::stages::out
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::setBatching(bool enable)
+    {
+        if(enable)
+        {
+            if(!_batch)
+            {
+                _batch = crypto::BatchCipher::attach();
+            }
+            return;
+        }
+
+        if(_batch)
+        {
+            flushBatch();
+            _batch->cancel(this);
+            _batch.reset();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::batchCiphered(Bytes&& frame)
+    {
+        dbgAssert(_batchPending);
+        _batchPending--;
+
+        _outputEager = true;
+        _output.end().write(std::move(frame));
+        _protocol->linkHasOutput(this);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::setMaxFrameSize(uint32 size)
+    {
+        _maxFrameSize = std::clamp(size, _shortFrameSize, _longFrameSizeLimit);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Ciphering::exportKeys(uint32 frames, apip::SessionKeys& res)
+    {
+        if(!_payloadAllowed)
+        {
+            return false;
+        }
+
+        //кадры пачки уже получили свои номера, выдать их до внешних
+        flushBatch();
+
+        frames = _hs->outputLeaseLimit(frames, _maxFrameSize);
+        if(!frames)
+        {
+            return false;
+        }
+
+        Aead::Kind kind;
+        uint64 nonce;
+        if(!leaseNonces(frames, kind, res.key.data(), nonce, res.ad.data()))
+        {
+            return false;
+        }
+
+        _hs->outputLeased(frames, _maxFrameSize);
+
+        res.aead = static_cast<apip::Aead>(uint8(1) << static_cast<uint8>(kind));
+        res.nonce = nonce;
+        res.frames = frames;
+        res.maxFrameSize = _maxFrameSize;
+
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Ciphering::outputEager() const
+    {
+        return _outputEager;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::keyChanged()
+    {
+        _protocol->outputKeyChanged();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint16 Ciphering::getWantedEmptyPrefix() const
     {
-        //приплюсовать 3 байта на заголовок
-        return _wantedEmptyPrefix + _genericHeaderSize + _payloadHeaderSize;
+        //приплюсовать 5 байт на заголовок, с запасом под длинный
+        return _wantedEmptyPrefix + _genericHeaderSize + _longPayloadHeaderSize;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -92,6 +195,7 @@ namespace dci::module::stiac::stages::out
     {
         dbgAssert(!payload.empty());
 
+        _outputEager = true;
         _payload.end().write(std::move(payload));
 
         if(!_payloadAllowed)
@@ -108,6 +212,7 @@ namespace dci::module::stiac::stages::out
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Bytes Ciphering::flushOutput()
     {
+        _outputEager = false;
         return std::move(_output);
     }
 
@@ -116,34 +221,53 @@ namespace dci::module::stiac::stages::out
     {
         dbgAssert(!_payload.empty());
 
-        constexpr uint32 maxHeaderBodySize = 0x10000 - _macSize;
-        constexpr uint32 maxBodySize = maxHeaderBodySize - _genericHeaderSize - _payloadHeaderSize;
+        const bool longFrames = _maxFrameSize > _shortFrameSize;
+        const uint32 maxBodySize = _maxFrameSize;
+        const uint32 headerSize = _genericHeaderSize + (longFrames ? _longPayloadHeaderSize : _payloadHeaderSize);
+
+        std::array<uint8, _genericHeaderSize + _longPayloadHeaderSize> header;
+        static_assert(1 == _genericHeaderSize);
+        static_assert(2 == _payloadHeaderSize);
+        static_assert(4 == _longPayloadHeaderSize);
+
+        auto makeHeader = [&](bool last, uint32 bodySize)
+        {
+            if(longFrames)
+            {
+                header[0] = static_cast<uint8>(last ? MessageType::payloadLongLastChunk : MessageType::payloadLongChunk);
+                header[1] = bodySize & 0xff;
+                header[2] = (bodySize>>8) & 0xff;
+                header[3] = (bodySize>>16) & 0xff;
+                header[4] = (bodySize>>24) & 0xff;
+            }
+            else
+            {
+                header[0] = static_cast<uint8>(last ? MessageType::payloadLastChunk : MessageType::payloadChunk);
+                header[1] = bodySize & 0xff;
+                header[2] = (bodySize>>8) & 0xff;
+            }
+        };
 
         uint32 trafficSize = _payload.size();
 
         while(_payload.size() > maxBodySize)
         {
-            std::array<uint8, _genericHeaderSize + _payloadHeaderSize> header;
-            static_assert(1 == _genericHeaderSize);
-            static_assert(2 == _payloadHeaderSize);
-            header[0] = static_cast<uint8>(MessageType::payloadChunk);
-            header[1] = maxBodySize & 0xff;
-            header[2] = (maxBodySize>>8) & 0xff;
+            makeHeader(false, maxBodySize);
 
             bytes::Alter src(_payload.begin());
             Bytes chunk;
 
-            if(src.continuousDataOffset() >= sizeof(header))
+            if(src.continuousDataOffset() >= headerSize)
             {
-                src.advance(-int32(header.size()));
-                src.write(header.data(), header.size());
-                src.advance(-int32(header.size()));
-                src.removeTo(chunk, maxHeaderBodySize);
+                src.advance(-int32(headerSize));
+                src.write(header.data(), headerSize);
+                src.advance(-int32(headerSize));
+                src.removeTo(chunk, headerSize + maxBodySize);
             }
             else
             {
                 bytes::Alter dst(chunk.begin());
-                dst.write(header.data(), header.size());
+                dst.write(header.data(), headerSize);
                 src.removeTo(dst, maxBodySize);
             }
 
@@ -154,16 +278,11 @@ namespace dci::module::stiac::stages::out
             uint32 bodySize = _payload.size();
             dbgAssert(bodySize <= maxBodySize);
 
-            std::array<uint8, _genericHeaderSize + _payloadHeaderSize> header;
-            static_assert(1 == _genericHeaderSize);
-            static_assert(2 == _payloadHeaderSize);
-            header[0] = static_cast<uint8>(MessageType::payloadLastChunk);
-            header[1] = bodySize & 0xff;
-            header[2] = (bodySize>>8) & 0xff;
+            makeHeader(true, bodySize);
 
             bytes::Alter a(_payload.begin());
-            a.advance(-int32(header.size()));
-            a.write(header.data(), header.size());
+            a.advance(-int32(headerSize));
+            a.write(header.data(), headerSize);
             encrypt(std::move(_payload), false);
         }
 
@@ -173,6 +292,29 @@ namespace dci::module::stiac::stages::out
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Ciphering::encrypt(Bytes&& chunk, bool mixCiphertext2Hash)
     {
+        if(keyDeferred())
+        {
+            //кадр ждет ключа из пула DH
+            defer([this, frame = std::make_shared<Bytes>(std::move(chunk)), mixCiphertext2Hash]
+            {
+                encryptNow(std::move(*frame), mixCiphertext2Hash);
+            });
+            return;
+        }
+
+        encryptNow(std::move(chunk), mixCiphertext2Hash);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::encryptNow(Bytes&& chunk, bool mixCiphertext2Hash)
+    {
+        if(!mixCiphertext2Hash && encryptBatched(chunk))
+        {
+            return;
+        }
+
+        flushBatch();
+
         {
             //начать новое сообщение
             messageStart();
@@ -182,20 +324,8 @@ namespace dci::module::stiac::stages::out
                 mixHashStart();
             }
 
-            bytes::Alter alter(chunk.begin());
-
             //шифровать тело
-            while(!alter.atEnd())
-            {
-                messageEncipher(alter.continuousData4Write(), alter.continuousDataSize());
-
-                if(mixCiphertext2Hash)
-                {
-                    mixHashUpdate(alter.continuousData4Write(), alter.continuousDataSize());
-                }
-
-                alter.advanceChunks(1);
-            }
+            messageEncipher(chunk, mixCiphertext2Hash);
 
             //дописать мак
             uint8 macOut[_macSize];
@@ -207,6 +337,7 @@ namespace dci::module::stiac::stages::out
                 mixHashFinish();
             }
 
+            bytes::Alter alter(chunk.end());
             alter.write(macOut, _macSize);
         }
 
@@ -214,4 +345,35 @@ namespace dci::module::stiac::stages::out
         _output.end().write(std::move(chunk));
         _protocol->linkHasOutput(this);
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Ciphering::encryptBatched(Bytes& chunk)
+    {
+        //пачкой умеет только chacha20poly1305ietf
+        if(!_batch || !_aead.chachaPoly() || chunk.size() > crypto::BatchCipher::_maxFrameSize)
+        {
+            return false;
+        }
+
+        crypto::BatchCipher::Job& job = _batch->enqueue(this);
+        bool started = messageStartDetached(job._key, job._nonce, job._ad);
+        dbgAssert(started);
+        (void)started;
+
+        job._data.resize(chunk.size());
+        chunk.begin().removeTo(job._data.data(), static_cast<uint32>(job._data.size()));
+
+        _batchPending++;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Ciphering::flushBatch()
+    {
+        if(_batchPending)
+        {
+            _batch->flush();
+            dbgAssert(!_batchPending);
+        }
+    }
 }
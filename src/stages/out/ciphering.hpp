@@ -10,6 +10,7 @@
 #include "pch.hpp"
 #include "../base.hpp"
 #include "../../crypto/symmetric.hpp"
+#include "../../crypto/batchCipher.hpp"
 
 namespace dci::module::stiac::stages::out
 {
@@ -19,10 +20,28 @@ namespace dci::module::stiac::stages::out
     {
     public:
         using Base::Base;
+        ~Ciphering();
 
         void urgent(MessageType mt, const void* data, uint32 dataSize);
         void allowPayload();
 
+        //шифрование кадров пачками с кадрами других соединений потока
+        void setBatching(bool enable);
+        void batchCiphered(Bytes&& frame);
+
+        //предел тела кадра, согласованный с удаленной стороной; сверх классического - длинные кадры
+        void setMaxFrameSize(uint32 size);
+
+        //номера frames кадров на текущем ключе внешнему шифровальщику, false до окончания рукопожатия
+        bool exportKeys(uint32 frames, apip::SessionKeys& res);
+
+        //в выходе есть что-то кроме подтверждений смены ключа (keyApplied), которые могут подождать
+        //попутной выдачи
+        bool outputEager() const;
+
+    private:
+        void keyChanged() override;
+
     private:
         uint16 getWantedEmptyPrefix() const override;
         void input(Bytes&& payload) override;
@@ -31,10 +50,18 @@ namespace dci::module::stiac::stages::out
     private:
         void flushPayload();
         void encrypt(Bytes&& chunk, bool mixCiphertext2Hash);
+        void encryptNow(Bytes&& chunk, bool mixCiphertext2Hash);
+        bool encryptBatched(Bytes& chunk);
+        void flushBatch();
 
     private:
         bool    _payloadAllowed = false;
+        bool    _outputEager = false;
         Bytes   _payload;
+        uint32  _maxFrameSize = _shortFrameSize;
+
+        crypto::BatchCipherPtr  _batch;
+        uint32                  _batchPending = 0;
     };
 
     using CipheringPtr = std::unique_ptr<Ciphering>;
@@ -26,6 +26,12 @@ namespace dci::module::stiac::stages::out
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Compression::setSliced(bool enable)
+    {
+        _sliced = enable;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint16 Compression::getWantedEmptyPrefix() const
     {
@@ -80,7 +86,10 @@ namespace dci::module::stiac::stages::out
             return std::move(output);
         };
 
-        while(!src.atEnd())
+        uint32 consumed = 0;
+
+        //порцию, но не пустую на выходе, иначе нечего отдать дальше
+        while(!src.atEnd() && (!_sliced || consumed < _sliceSize || output.size() <= reserved))
         {
             ZSTD_inBuffer inBuffer {src.continuousData(), src.continuousDataSize(), 0};
 
@@ -98,6 +107,14 @@ namespace dci::module::stiac::stages::out
             }
 
             src.remove(static_cast<uint32>(inBuffer.pos));
+            consumed += static_cast<uint32>(inBuffer.pos);
+        }
+
+        if(!src.atEnd())
+        {
+            //сообщение сжато не целиком, ступени ниже обработают порцию до следующей
+            _protocol->linkHasOutput(this);
+            return finalizer();
         }
 
         for(;;)
@@ -22,6 +22,9 @@ namespace dci::module::stiac::stages::out
         Compression(Protocol* protocol);
         ~Compression() override;
 
+        //сжимать порциями можно только если получатель собирает сообщения по длине впереди
+        void setSliced(bool enable);
+
     private:
         uint16 getWantedEmptyPrefix() const override;
         bool initialize() override;
@@ -29,6 +32,10 @@ namespace dci::module::stiac::stages::out
 
     private:
         ZSTD_CStream* _zcs;
+
+        //за один вызов сжимается не больше, остаток - на следующем проходе насоса
+        static constexpr uint32 _sliceSize = 1024*256;
+        bool _sliced = false;
     };
 
     using CompressionPtr = std::unique_ptr<Compression>;
@@ -17,11 +17,24 @@ namespace dci::module::stiac::stages::out
     {
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Cutting::setChecksum(Checksum::Kind kind)
+    {
+        _checksum = Checksum(kind);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Cutting::setMaxChunkSize(uint32 size)
+    {
+        //классический заголовок держит длину до 32767, все что выше - только varint
+        _maxChunkSize = size >= _classicChunkSize ? size : 0;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint16 Cutting::getWantedEmptyPrefix() const
     {
-        //приплюсовать 2 байта на заголовок
-        return _wantedEmptyPrefix + 2;
+        //приплюсовать заголовок, с запасом под varint
+        return _wantedEmptyPrefix + _maxHeaderSize;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -29,11 +42,12 @@ namespace dci::module::stiac::stages::out
     {
         dbgAssert(!msg.empty());
 
-        //в 32 килобайта надо упихать заголовок(2байта), данные(maxChunkBodySize), контрольную сумму(8байт)
-        const uint16 maxChunkBodySize =
-                0x8000                             // 32к
-                -2                                 // заголовок
-                -(_doIntegrityChecking ? (8) : 0); // контрольная сумма
+        //в 32 килобайта надо упихать заголовок(2байта), данные(maxChunkBodySize), контрольную сумму;
+        //в расширенном режиме предел только на тело
+        const uint32 maxChunkBodySize = _maxChunkSize ? _maxChunkSize :
+                _classicChunkSize                               // 32к
+                -2                                              // заголовок
+                -(_doIntegrityChecking ? _checksum.size() : 0); // контрольная сумма
 
         while(msg.size() > maxChunkBodySize)
         {
@@ -49,27 +63,58 @@ namespace dci::module::stiac::stages::out
     void Cutting::pushChunk(Bytes&& chunkData, bool finalize)
     {
         {
-            //заголовок: 15 бит длины + 1 бит признак последнего куска в сообщении
-            uint16 header = static_cast<uint16>(chunkData.size()) | (finalize ? uint16(1<<15) : uint16(0));
-            header = stiac::serialization::fixEndian(header);
+            std::array<uint8, _maxHeaderSize> header;
+            uint32 headerSize;
+
+            if(_maxChunkSize)
+            {
+                //varint (младшие 7 бит вперед) от длины со сдвигом и признака последнего куска
+                uint32 v = (chunkData.size() << 1) | (finalize ? 1 : 0);
+                headerSize = 0;
+                for(;;)
+                {
+                    header[headerSize++] = static_cast<uint8>(v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+                    v >>= 7;
+                    if(!v)
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                //заголовок: 15 бит длины + 1 бит признак последнего куска в сообщении
+                uint16 h = static_cast<uint16>(chunkData.size()) | (finalize ? uint16(1<<15) : uint16(0));
+                h = stiac::serialization::fixEndian(h);
+                std::memcpy(header.data(), &h, 2);
+                headerSize = 2;
+            }
 
             //писать заголовок перед данными
             bytes::Alter alter(chunkData.begin());
-            alter.advance(-2);
-            alter.write(&header, 2);
+            alter.advance(-static_cast<int32>(headerSize));
+            alter.write(header.data(), headerSize);
 
-            //дописать 8 байт контрольной суммы после данных
+            //дописать контрольную сумму после данных
             if(_doIntegrityChecking)
             {
-                Crc crc;
+                _checksum.reset();
                 while(!alter.atEnd())
                 {
-                    crc.process_bytes(alter.continuousData(), alter.continuousDataSize());
+                    _checksum.process(alter.continuousData(), alter.continuousDataSize());
                     alter.advanceChunks(1);
                 }
 
-                uint64 checksum = stiac::serialization::fixEndian(crc.checksum());
-                alter.write(&checksum, 8);
+                if(sizeof(uint64) == _checksum.size())
+                {
+                    uint64 checksum = stiac::serialization::fixEndian(_checksum.value());
+                    alter.write(&checksum, sizeof(checksum));
+                }
+                else
+                {
+                    uint32 checksum = stiac::serialization::fixEndian(static_cast<uint32>(_checksum.value()));
+                    alter.write(&checksum, sizeof(checksum));
+                }
             }
         }
 
@@ -9,6 +9,7 @@
 
 #include "pch.hpp"
 #include "../base.hpp"
+#include "../checksum.hpp"
 
 namespace dci::module::stiac::stages::out
 {
@@ -21,6 +22,11 @@ namespace dci::module::stiac::stages::out
     public:
         Cutting(Protocol* protocol, bool doIntegrityChecking);
 
+        void setChecksum(Checksum::Kind kind);
+
+        //предел тела куска, сверх классического - заголовок varint. Не согласуется, у сторон должен совпадать
+        void setMaxChunkSize(uint32 size);
+
     private:
         uint16 getWantedEmptyPrefix() const override;
         void input(Bytes&& msg) override;
@@ -30,20 +36,11 @@ namespace dci::module::stiac::stages::out
 
     private:
         bool _doIntegrityChecking = true;
+        Checksum _checksum;
 
-        /* CRC64 variant with "Jones" coefficients and init value of 0.
-         *
-         * Specification of this CRC64 variant follows:
-         * Name: crc-64-jones
-         * Width: 64 bites
-         * Poly: 0xad93d23594c935a9
-         * Reflected In: True
-         * Xor_In: 0xffffffffffffffff
-         * Reflected_Out: True
-         * Xor_Out: 0x0
-         * Check("123456789"): 0xe9c6d914c4b8d9ca
-         */
-        using Crc = boost::crc_optimal<64, 0xad93d23594c935a9, 0, 0, true, true>;
+        static constexpr uint32 _classicChunkSize = 0x8000;
+        static constexpr uint32 _maxHeaderSize = 5;
+        uint32 _maxChunkSize = 0;//0 - классический заголовок
     };
 
     using CuttingPtr = std::unique_ptr<Cutting>;
@@ -0,0 +1,127 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>            _i1;
+        Victim<>::Opposite  _i2;
+
+        uint64 _traffic2 = 0;
+        uint32 _calls1 = 0;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(protocol::Requirements requirements)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = requirements;
+            _outputRequirements = requirements;
+
+            init();
+
+            if(protocol::Requirements::ciphering == requirements)
+            {
+                _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+                _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            }
+
+            _p1->setAbortThreshold(1024*1024);
+            _p2->setAbortThreshold(1024*1024);
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                _r2->input(std::move(data));
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                _traffic2 += data.size();
+                _r1->input(std::move(data));
+            };
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _i1.init2();
+            _i1->out_m1() += [this](String s, bool)
+            {
+                _calls1++;
+                return readyFuture(String(std::to_string(s.size())));
+            };
+
+            _l1->put(idl::Interface(_i1.opposite())).value();
+        }
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void abortLarge(protocol::Requirements requirements)
+    {
+        Bundle b(requirements);
+
+        std::string content(1024*1024*4, '.');
+
+        //интерфейс уходит пока крупный вызов выдается порциями
+        b._traffic2 = 0;
+        (void)b._i2->out_m1(content, true);
+        b._i2.reset();
+
+        //второй интерфейс по тому же соединению работает, прерванное не доставлено
+        Victim<> i1;
+        i1.init2();
+        i1->out_m1() += [](String s, bool)
+        {
+            return readyFuture(String(std::to_string(s.size())));
+        };
+
+        b._l1->put(idl::Interface(i1.opposite())).value();
+        EXPECT_EQ(String("5"), b._i2->out_m1(String("small"), true).value());
+
+        EXPECT_LT(b._traffic2, content.size()/2);
+        EXPECT_EQ(0u, b._calls1);
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, abort_cutting)
+{
+    abortLarge(protocol::Requirements::integrity);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, abort_ciphering)
+{
+    abortLarge(protocol::Requirements::ciphering);
+}
@@ -0,0 +1,393 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <dci/test.hpp>
+#include "crypto/aead.hpp"
+#include <array>
+#include <chrono>
+#include <iostream>
+
+using namespace dci;
+using namespace dci::module::stiac::crypto;
+
+namespace
+{
+    //известные ответы, нонс 12 байт
+    struct Vector
+    {
+        const char* _key;
+        const char* _nonce;
+        const char* _ad;
+        const char* _plain;
+        const char* _cipher;
+        const char* _tag;
+    };
+
+    //NIST GCM, AES-256, test cases 13-16 из спецификации GCM
+    const Vector aesGcmVectors[] =
+    {
+        {
+            "0000000000000000000000000000000000000000000000000000000000000000",
+            "000000000000000000000000",
+            "",
+            "",
+            "",
+            "530f8afbc74536b9a963b4f1c4cb738b",
+        },
+        {
+            "0000000000000000000000000000000000000000000000000000000000000000",
+            "000000000000000000000000",
+            "",
+            "00000000000000000000000000000000",
+            "cea7403d4d606b6e074ec5d3baf39d18",
+            "d0d1c8a799996bf0265b98b5d48ab919",
+        },
+        {
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+            "cafebabefacedbaddecaf888",
+            "",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+            "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad",
+            "b094dac5d93471bdec1a502270e3cc6c",
+        },
+        {
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+            "cafebabefacedbaddecaf888",
+            "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+            "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+            "76fc6ece0f4e1768cddf8853bb2d551b",
+        },
+    };
+
+    //RFC 8439, 2.8.2
+    const Vector chachaPolyVector
+    {
+        "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+        "070000004041424344454647",
+        "50515253c0c1c2c3c4c5c6c7",
+        "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+        "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+        "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+        "637265656e20776f756c642062652069742e",
+        "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+        "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+        "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+        "3ff4def08e4b7a9de576d26586cec64b6116",
+        "1ae10b594f09e26a7e902ecbd0600691",
+    };
+
+    //ключ, нонс и ad из RFC 8439, 2.8.2, открытый текст 4096 байт i%256 - хватает на многоблочные пути;
+    //ответ получен от OpenSSL, шифротекст сверяется по хвосту, остальное покрывает подпись
+    struct LongVector
+    {
+        uint32      _size;
+        const char* _cipherTail;
+        const char* _tag;
+    };
+
+    const LongVector chachaPolyLongVector
+    {
+        4096,
+        "73d664f8b3c30529e1948fe5844fe24c",
+        "ebfa0b08b5997d06b91fe4a76a392a92",
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint8> fromHex(const char* hex)
+    {
+        std::vector<uint8> res;
+        for(std::size_t i(0); hex[i] && hex[i+1]; i+=2)
+        {
+            res.push_back(static_cast<uint8>(std::stoul(std::string(hex+i, 2), nullptr, 16)));
+        }
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //целиком и порциями разного размера, обратно и с испорченной подписью
+    template <class A>
+    void check(const Vector& v)
+    {
+        std::vector<uint8> key = fromHex(v._key);
+        std::vector<uint8> nonce = fromHex(v._nonce);
+        std::vector<uint8> ad = fromHex(v._ad);
+        std::vector<uint8> plain = fromHex(v._plain);
+        std::vector<uint8> cipher = fromHex(v._cipher);
+        std::vector<uint8> tag = fromHex(v._tag);
+
+        for(uint32 portion : {uint32(0), uint32(1), uint32(7), uint32(16), uint32(17)})
+        {
+            A a;
+            a.setKey(key.data(), static_cast<uint32>(key.size()));
+            a.setAd(ad.data(), static_cast<uint32>(ad.size()));
+            a.start(nonce.data(), static_cast<uint32>(nonce.size()));
+
+            std::vector<uint8> out(plain.size());
+            for(std::size_t pos(0); pos < plain.size(); )
+            {
+                uint32 size = static_cast<uint32>(std::min<std::size_t>(portion ? portion : plain.size(), plain.size() - pos));
+                a.encipher(plain.data()+pos, out.data()+pos, size);
+                pos += size;
+            }
+
+            uint8 mac[16];
+            a.encipherFinish(mac);
+
+            EXPECT_EQ(cipher, out);
+            EXPECT_EQ(tag, std::vector<uint8>(mac, mac+16));
+        }
+
+        for(bool spoil : {false, true})
+        {
+            A a;
+            a.setKey(key.data(), static_cast<uint32>(key.size()));
+            a.setAd(ad.data(), static_cast<uint32>(ad.size()));
+            a.start(nonce.data(), static_cast<uint32>(nonce.size()));
+
+            std::vector<uint8> out(cipher.size());
+            a.decipher(cipher.data(), out.data(), static_cast<uint32>(cipher.size()));
+
+            std::vector<uint8> mac = tag;
+            mac[0] ^= spoil ? 1 : 0;
+
+            EXPECT_EQ(!spoil, a.decipherFinish(mac.data()));
+            EXPECT_EQ(plain, out);
+        }
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, aead_aesGcmKnownAnswers)
+{
+    //программного пути нет, без AES-NI проверять нечего
+    if(!AesGcm::available())
+    {
+        GTEST_SKIP();
+    }
+
+    for(const Vector& v : aesGcmVectors)
+    {
+        check<AesGcm>(v);
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, aead_chachaPolyKnownAnswers)
+{
+    //скалярный путь, затем AVX2 если процессор умеет
+    for(bool accelerated : {false, true})
+    {
+        ChaChaPoly::setAccelerated(accelerated);
+
+        check<ChaChaPoly>(chachaPolyVector);
+
+        std::vector<uint8> key = fromHex(chachaPolyVector._key);
+        std::vector<uint8> nonce = fromHex(chachaPolyVector._nonce);
+        std::vector<uint8> ad = fromHex(chachaPolyVector._ad);
+
+        std::vector<uint8> plain(chachaPolyLongVector._size);
+        for(uint32 i(0); i<plain.size(); ++i)
+        {
+            plain[i] = static_cast<uint8>(i);
+        }
+
+        std::vector<uint8> cipherTail = fromHex(chachaPolyLongVector._cipherTail);
+        std::vector<uint8> tag = fromHex(chachaPolyLongVector._tag);
+
+        //порции и через границы многоблочных прогонов, и внутри них
+        for(uint32 portion : {uint32(0), uint32(17), uint32(600), uint32(1500)})
+        {
+            ChaChaPoly a;
+            a.setKey(key.data(), static_cast<uint32>(key.size()));
+            a.setAd(ad.data(), static_cast<uint32>(ad.size()));
+            a.start(nonce.data(), static_cast<uint32>(nonce.size()));
+
+            std::vector<uint8> out(plain.size());
+            for(std::size_t pos(0); pos < plain.size(); )
+            {
+                uint32 size = static_cast<uint32>(std::min<std::size_t>(portion ? portion : plain.size(), plain.size() - pos));
+                a.encipher(plain.data()+pos, out.data()+pos, size);
+                pos += size;
+            }
+
+            uint8 mac[16];
+            a.encipherFinish(mac);
+
+            EXPECT_EQ(cipherTail, std::vector<uint8>(out.end()-16, out.end()));
+            EXPECT_EQ(tag, std::vector<uint8>(mac, mac+16));
+
+            ChaChaPoly d;
+            d.setKey(key.data(), static_cast<uint32>(key.size()));
+            d.setAd(ad.data(), static_cast<uint32>(ad.size()));
+            d.start(nonce.data(), static_cast<uint32>(nonce.size()));
+
+            std::vector<uint8> back(out.size());
+            d.decipher(out.data(), back.data(), static_cast<uint32>(out.size()));
+            EXPECT_TRUE(d.decipherFinish(mac));
+            EXPECT_EQ(plain, back);
+        }
+    }
+
+    ChaChaPoly::setAccelerated(true);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, aead_chachaPolyLanesKnownAnswers)
+{
+    //11 сообщений - полная восьмерка и неполная; первые два с известными ответами,
+    //остальные разной длины сверяются с одиночным расчетом
+    constexpr uint32 amount = 11;
+
+    for(bool accelerated : {false, true})
+    {
+        ChaChaPoly::setAccelerated(accelerated);
+
+        std::vector<uint8> key = fromHex(chachaPolyVector._key);
+        std::vector<uint8> nonce = fromHex(chachaPolyVector._nonce);
+        std::vector<uint8> ad = fromHex(chachaPolyVector._ad);
+
+        ChaChaPoly keyHolder;
+        keyHolder.setKey(key.data(), static_cast<uint32>(key.size()));
+
+        std::vector<std::vector<uint8>> plains(amount);
+        std::vector<std::vector<uint8>> datas(amount);
+        std::vector<std::array<uint8, 12>> nonces(amount);
+        std::vector<std::array<uint8, 16>> tags(amount);
+        std::vector<ChaChaPoly::Lane> lanes(amount);
+
+        for(uint32 l(0); l<amount; ++l)
+        {
+            if(0 == l)
+            {
+                plains[l] = fromHex(chachaPolyVector._plain);
+            }
+            else
+            {
+                plains[l].resize(1 == l ? chachaPolyLongVector._size : l*97);
+                for(uint32 i(0); i<plains[l].size(); ++i)
+                {
+                    plains[l][i] = static_cast<uint8>(i);
+                }
+            }
+
+            datas[l] = plains[l];
+            std::copy(nonce.begin(), nonce.end(), nonces[l].begin());
+            nonces[l][11] = static_cast<uint8>(nonces[l][11] + (l > 1 ? l : 0));
+
+            lanes[l] = ChaChaPoly::Lane{keyHolder.keyWords(), nonces[l].data(), ad.data(), static_cast<uint32>(ad.size()),
+                                        datas[l].data(), static_cast<uint32>(datas[l].size()), tags[l].data()};
+        }
+
+        ChaChaPoly::encipherLanes(lanes.data(), amount);
+
+        EXPECT_EQ(fromHex(chachaPolyVector._cipher), datas[0]);
+        EXPECT_EQ(fromHex(chachaPolyVector._tag), std::vector<uint8>(tags[0].begin(), tags[0].end()));
+
+        EXPECT_EQ(fromHex(chachaPolyLongVector._cipherTail), std::vector<uint8>(datas[1].end()-16, datas[1].end()));
+        EXPECT_EQ(fromHex(chachaPolyLongVector._tag), std::vector<uint8>(tags[1].begin(), tags[1].end()));
+
+        for(uint32 l(2); l<amount; ++l)
+        {
+            ChaChaPoly a;
+            a.setKey(key.data(), static_cast<uint32>(key.size()));
+            a.setAd(ad.data(), static_cast<uint32>(ad.size()));
+            a.start(nonces[l].data(), static_cast<uint32>(nonces[l].size()));
+
+            std::vector<uint8> out(plains[l].size());
+            a.encipher(plains[l].data(), out.data(), static_cast<uint32>(out.size()));
+
+            uint8 mac[16];
+            a.encipherFinish(mac);
+
+            EXPECT_EQ(out, datas[l]);
+            EXPECT_EQ(std::vector<uint8>(mac, mac+16), std::vector<uint8>(tags[l].begin(), tags[l].end()));
+        }
+    }
+
+    ChaChaPoly::setAccelerated(true);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, aead_throughput)
+{
+    //поток сообщений по 16к через каждый доступный алгоритм
+    constexpr uint32 messageSize = 1024*16;
+    constexpr uint32 messages = 1024*4;
+
+    std::vector<uint8> key(32, 0x5a);
+    std::vector<uint8> data(messageSize, 0xa5);
+
+    for(uint8 k(0); k<Aead::_kindsAmount; ++k)
+    {
+        Aead::Kind kind = static_cast<Aead::Kind>(k);
+        if(!Aead::available(kind))
+        {
+            continue;
+        }
+
+        Aead a;
+        a.setKind(kind);
+        a.setKey(key.data(), static_cast<uint32>(key.size()));
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for(uint64 n(0); n<messages; ++n)
+        {
+            uint8 mac[16];
+            a.start(&n, sizeof(n));
+            a.encipher(data.data(), data.data(), messageSize);
+            a.encipherFinish(mac);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout<<"aead kind "<<int(k)<<": "<<static_cast<uint64>(double(messageSize) * messages / seconds / 1024 / 1024)<<" MB/s"<<std::endl;
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, aead_macOnlyCost)
+{
+    //режим только аутентификации: на байт остается Poly1305 без гаммы ChaCha20
+    constexpr uint32 messageSize = 1024*16;
+    constexpr uint32 messages = 1024*4;
+
+    std::vector<uint8> key(32, 0x5a);
+    std::vector<uint8> data(messageSize, 0xa5);
+
+    auto measure = [&](Aead::Kind kind)
+    {
+        Aead a;
+        a.setKind(kind);
+        a.setKey(key.data(), static_cast<uint32>(key.size()));
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for(uint64 n(0); n<messages; ++n)
+        {
+            uint8 mac[16];
+            a.start(&n, sizeof(n));
+            a.encipher(data.data(), data.data(), messageSize);
+            a.encipherFinish(mac);
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    double full = measure(Aead::Kind::chacha20poly1305ietf);
+    double macOnly = measure(Aead::Kind::poly1305);
+
+    std::cout<<"chacha20poly1305ietf "<<static_cast<uint64>(double(messageSize) * messages / full / 1024 / 1024)<<" MB/s, "
+             <<"poly1305 mac only "<<static_cast<uint64>(double(messageSize) * messages / macOnly / 1024 / 1024)<<" MB/s"<<std::endl;
+
+    EXPECT_LT(macOnly, full);
+}
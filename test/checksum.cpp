@@ -0,0 +1,109 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <dci/test.hpp>
+#include "stages/checksum.hpp"
+#include <boost/crc.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace dci;
+using namespace dci::module::stiac::stages;
+
+namespace
+{
+    using Crc64Reference = boost::crc_optimal<64, 0xad93d23594c935a9, 0, 0, true, true>;
+    using Crc32cReference = boost::crc_optimal<32, 0x1edc6f41, 0xffffffff, 0xffffffff, true, true>;
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, checksum_reference)
+{
+    //случайные длины, смещения и точки разбиения; табличный путь, затем PCLMUL/SSE4.2 если есть
+    std::mt19937 rnd(42);
+
+    std::vector<uint8> buffer(1024*64 + 64);
+    for(uint8& b : buffer)
+    {
+        b = static_cast<uint8>(rnd());
+    }
+
+    for(bool accelerated : {false, true})
+    {
+        Checksum::setAccelerated(accelerated);
+
+        for(uint32 iteration(0); iteration<2000; ++iteration)
+        {
+            std::size_t size = rnd() % (iteration < 1000 ? 600 : 1024*64);
+            std::size_t offset = rnd() % 64;
+            const uint8* data = buffer.data() + offset;
+
+            Crc64Reference ref64;
+            ref64.process_bytes(data, size);
+
+            Crc32cReference ref32c;
+            ref32c.process_bytes(data, size);
+
+            EXPECT_EQ(ref64.checksum(), Checksum::crc64(0, data, size));
+            EXPECT_EQ(ref32c.checksum(), Checksum::crc32c(0xffffffff, data, size) ^ 0xffffffff);
+
+            for(Checksum::Kind kind : {Checksum::Kind::crc64, Checksum::Kind::crc32c})
+            {
+                Checksum c(kind);
+
+                std::size_t pos = 0;
+                while(pos < size)
+                {
+                    std::size_t portion = std::min<std::size_t>(size - pos, 1 + rnd() % (rnd() % 2 ? 16 : 4096));
+                    c.process(data + pos, static_cast<uint32>(portion));
+                    pos += portion;
+                }
+
+                EXPECT_EQ(Checksum::Kind::crc64 == kind ? ref64.checksum() : uint64(ref32c.checksum()), c.value());
+            }
+        }
+    }
+
+    Checksum::setAccelerated(true);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, checksum_throughput)
+{
+    //кусками по 16к, как режут кадры в режиме целостности
+    constexpr uint32 chunkSize = 1024*16;
+    constexpr uint32 chunks = 1024*4;
+
+    std::vector<uint8> data(chunkSize, 0xa5);
+
+    for(bool accelerated : {false, true})
+    {
+        Checksum::setAccelerated(accelerated);
+
+        for(Checksum::Kind kind : {Checksum::Kind::crc64, Checksum::Kind::crc32c})
+        {
+            Checksum c(kind);
+
+            auto begin = std::chrono::steady_clock::now();
+
+            for(uint32 n(0); n<chunks; ++n)
+            {
+                c.reset();
+                c.process(data.data(), chunkSize);
+                data[n % chunkSize] ^= static_cast<uint8>(c.value());
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            std::cout<<(Checksum::Kind::crc64 == kind ? "crc64" : "crc32c")<<(accelerated ? ", accelerated" : ", table")<<": "
+                     <<static_cast<uint64>(double(chunkSize) * chunks / seconds / 1024 / 1024)<<" MB/s"<<std::endl;
+        }
+    }
+
+    Checksum::setAccelerated(true);
+}
@@ -5,163 +5,334 @@
    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
    You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
 
-#include "utils/bundle.hpp"
-#include "test/victimInterface.hpp"
+#include "utils/cipheringBundle.hpp"
+#include "utils/delay.hpp"
+#include <iostream>
 
-using namespace dci::idl::stiac::test;
+using Bundle = utils::CipheringBundle;
+using utils::resBuilder;
+using utils::bulkExchange;
 
-namespace
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering)
 {
-    struct Bundle
-        : public ::utils::Bundle
-    {
-        Victim<>            _i1;
-        Victim<>::Opposite  _i2;
-
-        bool _forceCorrupt1 = false;
-        bool _forceCorrupt2 = false;
-
-        bool _fail1 = false;
-        bool _fail2 = false;
+    Bundle b;
 
-        bool _integrityViolationFail1 = false;
-        bool _integrityViolationFail2 = false;
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
 
-        Bundle()
-            : ::utils::Bundle(false, false)
+    for(int k(0); k<3; ++k)
+    {
+        for(int k2(0); k2<6; ++k2)
         {
-            _inputRequirements = protocol::Requirements::ciphering;
-            _outputRequirements = protocol::Requirements::ciphering;
-
-            init();
-
-            _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
-            _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            std::string content = "content_"+std::to_string(k2)+"_"+std::string(static_cast<std::size_t>(1000*k2 + k), '.');
+            EXPECT_TRUE(resBuilder(content, k2%2) == b._i2->out_m1(content, k2%2).value());
+        }
+    }
 
-            _session.flush();
-            _r1->output() += _session * [this](Bytes&& data)
-            {
-                if(_forceCorrupt1)
-                {
-                    char c;
-                    data.begin().read(&c, 1);
-                    c ^= 1;
-                    data.begin().write(&c, 1);
-                }
-
-                while(!data.empty())
-                {
-                    Bytes granula;
-                    data.begin().removeTo(granula, 1);
-                    _r2->input(std::move(granula));
-                }
-            };
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
 
-            _r2->output() += _session * [this](Bytes&& data)
-            {
-                if(_forceCorrupt2)
-                {
-                    char c;
-                    data.begin().read(&c, 1);
-                    c ^= 1;
-                    data.begin().write(&c, 1);
-                }
-
-                //лить данные мелкой гранулой, чтобы проверить как их гранулирует кифер
-                while(!data.empty())
-                {
-                    Bytes granula;
-                    data.begin().removeTo(granula, 1);
-                    _r1->input(std::move(granula));
-                }
-            };
+    b._forceCorrupt2 = true;
+    std::string content = "content_"+std::string(50, '.');
+    b._i2->out_m1(content, true);
+    EXPECT_TRUE(b._integrityViolationFail1);
+}
 
-            _p2->failed() += [&](ExceptionPtr e)
-            {
-                _fail2 = true;
-
-                try
-                {
-                    std::rethrow_exception(e);
-                }
-                catch(const protocol::IntegrityViolation&)
-                {
-                    _integrityViolationFail2 = true;
-                    //std::cout<<"fail 2: "<<e.what()<<std::endl;
-                }
-                catch(const protocol::DecipheringFail&)
-                {
-                    _integrityViolationFail2 = true;
-                    //std::cout<<"fail 2: "<<e.what()<<std::endl;
-                }
-            };
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_aes256gcm)
+{
+    //без AES-NI стороны договорятся на chacha20poly1305, тест все равно должен проходить
+    Bundle b({.aeads = protocol::Aead::chacha20poly1305 | protocol::Aead::aes256gcm});
+    bulkExchange(b);
+}
 
-            _p1->failed() += [&](ExceptionPtr e)
-            {
-                _fail1 = true;
-
-                try
-                {
-                    std::rethrow_exception(e);
-                }
-                catch(const protocol::IntegrityViolation&)
-                {
-                    _integrityViolationFail1 = true;
-                    //std::cout<<"fail 1: "<<e.what()<<std::endl;
-                }
-                catch(const protocol::DecipheringFail&)
-                {
-                    _integrityViolationFail1 = true;
-                    //std::cout<<"fail 1: "<<e.what()<<std::endl;
-                }
-            };
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_chacha20poly1305ietf)
+{
+    Bundle b({.aeads = protocol::Aead::chacha20poly1305 | protocol::Aead::chacha20poly1305ietf});
+    bulkExchange(b);
+}
 
-            start();
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_batched)
+{
+    //мелкие кадры идут пачкой, крупные и служебные - напрямую, порядок должен сохраниться
+    Bundle b({.aeads = protocol::Aead::chacha20poly1305 | protocol::Aead::chacha20poly1305ietf, .batching = true});
+    bulkExchange(b);
+}
 
-            _l2->got() += [&](idl::Interface&& i)
-            {
-                _i2 = i;
-                return readyFuture(None{});
-            };
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_longFrames)
+{
+    //сообщения до 100к уходят одним длинным кадром вместо двух классических
+    Bundle b({.maxFrameSize = 1024*1024});
+    bulkExchange(b);
+}
 
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_authentication)
+{
+    //данные идут открыто, подмена все равно обнаруживается
+    Bundle b({.requirements = protocol::Requirements::authentication});
+    bulkExchange(b);
+}
 
-            _l1->put(idl::Interface(_i1.init2())).value();
-        }
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_rekeyPolicy)
+{
+    Bundle b;
 
+    b._p1->setRekeyPolicy(4, 0, 0);
+    b._p2->setRekeyPolicy(4, 0, 0);
 
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
     };
 
-
-    String resBuilder(String s, bool b)
+    for(int k(0); k<32; ++k)
     {
-        return "pre_" + s + "_mid_" + (b ? "true" : "false") + "_post";
+        std::string content = "content_"+std::to_string(k);
+        EXPECT_TRUE(resBuilder(content, k%2) == b._i2->out_m1(content, k%2).value());
     }
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    protocol::Stats s1 = b._p1->stats().value();
+    protocol::Stats s2 = b._p2->stats().value();
+
+    EXPECT_GT(s1.rekeys, 0u);
+    EXPECT_GT(s2.rekeys, 0u);
+    EXPECT_EQ(s1.remoteRekeys, s2.rekeys);
+    EXPECT_EQ(s2.remoteRekeys, s1.rekeys);
 }
 
 /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-TEST(module_stiac, ciphering)
+TEST(module_stiac, ciphering_ratchet)
 {
-    Bundle b;
+    //из каждых четырех смен ключа три храповиком и одна через DH
+    Bundle b({.ratchet = 3});
+
+    b._p1->setRekeyPolicy(4, 0, 0);
+    b._p2->setRekeyPolicy(4, 0, 0);
 
     b._i1->out_m1() += [](String s, bool b)
     {
         return readyFuture(resBuilder(s, b));
     };
 
-    for(int k(0); k<3; ++k)
+    for(int k(0); k<64; ++k)
     {
-        for(int k2(0); k2<6; ++k2)
-        {
-            std::string content = "content_"+std::to_string(k2)+"_"+std::string(static_cast<std::size_t>(1000*k2 + k), '.');
-            EXPECT_TRUE(resBuilder(content, k2%2) == b._i2->out_m1(content, k2%2).value());
-        }
+        std::string content = "content_"+std::to_string(k);
+        EXPECT_TRUE(resBuilder(content, k%2) == b._i2->out_m1(content, k%2).value());
     }
 
     EXPECT_FALSE(b._fail1);
     EXPECT_FALSE(b._fail2);
 
+    protocol::Stats s1 = b._p1->stats().value();
+    protocol::Stats s2 = b._p2->stats().value();
+
+    EXPECT_GT(s1.ratchets, 0u);
+    EXPECT_GT(s2.ratchets, 0u);
+    EXPECT_GT(s1.remoteRatchets, 0u);
+    EXPECT_GT(s2.remoteRatchets, 0u);
+
+    EXPECT_GT(s1.rekeys, 0u);
+    EXPECT_GT(s1.ratchets, s1.rekeys);
+
     b._forceCorrupt2 = true;
     std::string content = "content_"+std::string(50, '.');
     b._i2->out_m1(content, true);
     EXPECT_TRUE(b._integrityViolationFail1);
 }
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_ratchetBeforeStart)
+{
+    //храповик и политика заданы только до старта, живых перенастроек нет
+    Bundle b({.ratchet = 3, .rekeyMessages = 4});
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    for(int k(0); k<16; ++k)
+    {
+        std::string content = "content_"+std::to_string(k);
+        EXPECT_TRUE(resBuilder(content, k%2) == b._i2->out_m1(content, k%2).value());
+    }
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    protocol::Stats s1 = b._p1->stats().value();
+    protocol::Stats s2 = b._p2->stats().value();
+
+    EXPECT_GT(s1.ratchets, 0u);
+    EXPECT_GT(s2.ratchets, 0u);
+    EXPECT_GT(s1.remoteRatchets, 0u);
+    EXPECT_GT(s2.remoteRatchets, 0u);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_handshakeOffload)
+{
+    //DH в рабочих потоках, частые смены ключа проверяют порядок отложенного
+    Bundle b({.offload = true});
+
+    b._p1->setRekeyPolicy(4, 0, 0);
+    b._p2->setRekeyPolicy(4, 0, 0);
+
+    bulkExchange(b);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_handshakeStorm)
+{
+    //шквал подключений на одном потоке при круге 10мс: рукопожатий в секунду и время до первой нагрузки,
+    //DH на месте и в рабочих потоках
+    auto measure = [](bool offload)
+    {
+        constexpr std::size_t amount = 200;
+
+        struct Connection
+        {
+            Bundle _b;
+            utils::Delay _d12{std::chrono::milliseconds{5}, [this](Bytes&& data){_b._r2->input(std::move(data));}};
+            utils::Delay _d21{std::chrono::milliseconds{5}, [this](Bytes&& data){_b._r1->input(std::move(data));}};
+            std::chrono::steady_clock::time_point _got;
+
+            Connection(bool offload)
+                : _b{{.offload = offload}, false}
+            {
+                _b._session.flush();
+                _b._r1->output() += _b._session * [this](Bytes&& data){_d12.push(std::move(data));};
+                _b._r2->output() += _b._session * [this](Bytes&& data){_d21.push(std::move(data));};
+            }
+        };
+
+        std::vector<std::unique_ptr<Connection>> connections;
+        std::vector<cmt::Future<None>> puts;
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for(std::size_t i(0); i<amount; ++i)
+        {
+            Connection& c = *connections.emplace_back(std::make_unique<Connection>(offload));
+
+            c._b.utils::Bundle::start();
+            c._b._l2->got() += [&c](idl::Interface&& i)
+            {
+                c._b._i2 = i;
+                c._got = std::chrono::steady_clock::now();
+                return readyFuture(None{});
+            };
+
+            puts.push_back(c._b._l1->put(idl::Interface(c._b._i1.init2())));
+        }
+
+        std::chrono::steady_clock::duration firstPayload{};
+        for(std::size_t i(0); i<amount; ++i)
+        {
+            puts[i].value();
+            firstPayload += connections[i]->_got - begin;
+
+            EXPECT_FALSE(connections[i]->_b._fail1);
+            EXPECT_FALSE(connections[i]->_b._fail2);
+        }
+
+        auto total = std::chrono::steady_clock::now() - begin;
+
+        for(auto& c : connections)
+        {
+            c->_b._session.flush();
+        }
+
+        double rate = double(amount) / std::chrono::duration<double>(total).count();
+        auto meanFirstPayload = std::chrono::duration_cast<std::chrono::milliseconds>(firstPayload / amount);
+
+        std::cout<<"handshake storm, "<<amount<<" connections, rtt 10ms, "<<(offload ? "offload" : "inline")<<": "
+                 <<static_cast<uint64>(rate)<<" handshakes/s, mean time to first payload "<<meanFirstPayload.count()<<"ms"<<std::endl;
+    };
+
+    measure(false);
+    measure(true);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_boundedInput)
+{
+    //сообщение 8Мб сегментами по 1к: с длиной впереди кадры уходят дальше по мере проверки и входное
+    //шифрование держит не больше пары кадров, без нее - сообщение целиком
+    for(bool lengthPrefix : {true, false})
+    {
+        Bundle b({}, false);
+
+        b._p1->setLengthPrefix(lengthPrefix);
+        b._p2->setLengthPrefix(lengthPrefix);
+
+        auto segmented = [](Bytes&& data, RemoteEdge<>& to)
+        {
+            while(!data.empty())
+            {
+                Bytes segment;
+                data.begin().removeTo(segment, 1024);
+                to->input(std::move(segment));
+            }
+        };
+
+        b._session.flush();
+        b._r1->output() += b._session * [&](Bytes&& data){segmented(std::move(data), b._r2);};
+        b._r2->output() += b._session * [&](Bytes&& data){segmented(std::move(data), b._r1);};
+
+        b.start();
+
+        b._i1->out_m1() += [](String s, bool)
+        {
+            return readyFuture(String(std::to_string(s.size())));
+        };
+
+        std::string content(1024*1024*8, '.');
+        EXPECT_EQ(std::to_string(content.size()), b._i2->out_m1(content, true).value());
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        uint64 peak = b._p1->stats().value().inputBufferedPeak;
+        std::cout<<"input buffered peak, 8Mb message, "<<(lengthPrefix ? "length prefix" : "whole messages")<<": "<<peak<<" bytes"<<std::endl;
+
+        if(lengthPrefix)
+        {
+            EXPECT_LT(peak, uint64(1024*256));
+        }
+        else
+        {
+            EXPECT_GE(peak, uint64(content.size()));
+        }
+
+        b._session.flush();
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, ciphering_lengthPrefix)
+{
+    //длина перед сообщениями только если ее объявили обе стороны, иначе целые сообщения как у прежних версий
+    for(auto [lengthPrefix1, lengthPrefix2] : {std::pair{true, true}, std::pair{true, false}, std::pair{false, true}})
+    {
+        Bundle b({.maxFrameSize = 1024*64}, false);
+
+        b._p1->setLengthPrefix(lengthPrefix1);
+        b._p2->setLengthPrefix(lengthPrefix2);
+
+        b.start();
+
+        bulkExchange(b);
+    }
+}
@@ -0,0 +1,150 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+#include <iostream>
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>            _i1;
+        Victim<>::Opposite  _i2;
+
+        uint32 _outputs1 = 0;
+        uint32 _outputs2 = 0;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(uint32 rekeyMessages = 1)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = protocol::Requirements::ciphering;
+            _outputRequirements = protocol::Requirements::ciphering;
+
+            init();
+
+            _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+            _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+
+            //по умолчанию смена ключа на каждом сообщении
+            _p1->setRekeyPolicy(rekeyMessages, 0, 0);
+            _p2->setRekeyPolicy(rekeyMessages, 0, 0);
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                _outputs1++;
+                _r2->input(std::move(data));
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                _outputs2++;
+                _r1->input(std::move(data));
+            };
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _l1->put(idl::Interface(_i1.init2())).value();
+        }
+    };
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, coalescing)
+{
+    Bundle b;
+
+    b._i1->out_m1() += [](String s, bool)
+    {
+        return readyFuture(String("re_" + s));
+    };
+
+    b._outputs1 = 0;
+    b._outputs2 = 0;
+
+    const uint32 calls = 100;
+    for(uint32 k(0); k<calls; ++k)
+    {
+        std::string content = "content_" + std::to_string(k);
+        EXPECT_EQ("re_" + content, b._i2->out_m1(content, true).value());
+    }
+
+    //смена ключа (ekey, keyApplied) не добавляет выдач: по одной на вызов и на ответ, keyApplied
+    //на ключ из ответа уходит со следующим вызовом
+    EXPECT_LE(b._outputs1, calls + 2);
+    EXPECT_LE(b._outputs2, calls + 2);
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, coalescing_rekeyCost)
+{
+    //выдачи и время на вызов со сменой ключа на каждом сообщении и без смен
+    const uint32 calls = 1000;
+
+    auto measure = [&](uint32 rekeyMessages)
+    {
+        Bundle b(rekeyMessages);
+
+        b._i1->out_m1() += [](String s, bool)
+        {
+            return readyFuture(String("re_" + s));
+        };
+
+        b._outputs1 = 0;
+        b._outputs2 = 0;
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for(uint32 k(0); k<calls; ++k)
+        {
+            std::string content = "content_" + std::to_string(k);
+            EXPECT_EQ("re_" + content, b._i2->out_m1(content, true).value());
+        }
+
+        auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        std::cout<<"rekey every "<<rekeyMessages<<" messages: "<<b._outputs1 + b._outputs2<<" outputs, "
+                 <<time.count() / calls<<"us per call, "<<calls<<" calls"<<std::endl;
+
+        return b._outputs1 + b._outputs2;
+    };
+
+    uint32 withRekeys = measure(1);
+    uint32 withoutRekeys = measure(0);
+
+    //смены ключа едут в тех же выдачах, что и вызовы
+    EXPECT_LE(withRekeys, withoutRekeys + 4);
+}
@@ -0,0 +1,114 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>            _i1;
+        Victim<>::Opposite  _i2;
+
+        uint64 _traffic2 = 0;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(protocol::Requirements requirements, bool compact1, bool compact2)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = requirements;
+            _outputRequirements = requirements;
+
+            init();
+
+            if(protocol::Requirements::ciphering == requirements)
+            {
+                _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+                _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            }
+
+            _p1->setCompactIds(compact1);
+            _p2->setCompactIds(compact2);
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                _r2->input(std::move(data));
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                _traffic2 += data.size();
+                _r1->input(std::move(data));
+            };
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _i1.init2();
+            _i1->out_m1() += [](String s, bool)
+            {
+                return readyFuture(String(std::to_string(s.size())));
+            };
+
+            _l1->put(idl::Interface(_i1.opposite())).value();
+        }
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 traffic(protocol::Requirements requirements, bool compact1, bool compact2)
+    {
+        Bundle b(requirements, compact1, compact2);
+
+        b._traffic2 = 0;
+        for(uint32 i(0); i<100; ++i)
+        {
+            EXPECT_EQ("1", b._i2->out_m1(String("x"), true).value());
+        }
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        return b._traffic2;
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, compactIds)
+{
+    EXPECT_LT(traffic(protocol::Requirements::null, true, true), traffic(protocol::Requirements::null, false, false));
+    EXPECT_LT(traffic(protocol::Requirements::ciphering, true, true), traffic(protocol::Requirements::ciphering, false, false));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, compactIds_oneSide)
+{
+    //каждая сторона объявляет свой выход маркером, вход следует объявлению
+    EXPECT_LT(traffic(protocol::Requirements::ciphering, false, true), traffic(protocol::Requirements::ciphering, false, false));
+    traffic(protocol::Requirements::ciphering, true, false);
+}
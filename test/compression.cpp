@@ -21,7 +21,7 @@ namespace
         bool _fail1 = false;
         bool _fail2 = false;
 
-        Bundle()
+        Bundle(bool lengthPrefix = false)
             : ::utils::Bundle(false, false)
         {
             _inputRequirements = protocol::Requirements::compression;
@@ -29,6 +29,9 @@ namespace
 
             init();
 
+            _p1->setLengthPrefix(lengthPrefix);
+            _p2->setLengthPrefix(lengthPrefix);
+
             _l2->failed() += [&](ExceptionPtr e)
             {
                 _fail2 = true;
@@ -99,3 +102,31 @@ TEST(module_stiac, compression)
     EXPECT_FALSE(b._fail1);
     EXPECT_FALSE(b._fail2);
 }
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, compression_large)
+{
+    //слабо сжимаемое содержимое в несколько порций сжатия: с длиной впереди проходит цепь по частям, без нее - целиком
+    std::string content(1024*1024*4, '.');
+    uint32 state = 42;
+    for(char& c : content)
+    {
+        state = state * 1103515245 + 12345;
+        c = static_cast<char>('a' + (state >> 16) % 26);
+    }
+
+    for(bool lengthPrefix : {false, true})
+    {
+        Bundle b{lengthPrefix};
+
+        b._i1->out_m1() += [](String s, bool b)
+        {
+            return readyFuture(String(std::to_string(s.size()) + "_" + s.substr(s.size()/2, 16) + (b ? "_true" : "_false")));
+        };
+
+        EXPECT_EQ(std::to_string(content.size()) + "_" + content.substr(content.size()/2, 16) + "_true", b._i2->out_m1(content, true).value());
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+    }
+}
@@ -0,0 +1,161 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>            _i1;
+        Victim<>::Opposite  _i2;
+
+        uint64 _traffic2 = 0;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(protocol::Requirements requirements = protocol::Requirements::null, uint32 cacheSize1 = 1024*1024*16)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = requirements;
+            _outputRequirements = requirements;
+
+            init();
+
+            if(protocol::Requirements::ciphering == requirements)
+            {
+                _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+                _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            }
+
+            _p1->setDeduplication(1024*64, cacheSize1);
+            _p2->setDeduplication(1024*64, 1024*1024*16);
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                _r2->input(std::move(data));
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                _traffic2 += data.size();
+                _r1->input(std::move(data));
+            };
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _l1->put(idl::Interface(_i1.init2())).value();
+        }
+    };
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, deduplication)
+{
+    Bundle b;
+
+    b._i1->out_m1() += [](String s, bool)
+    {
+        return readyFuture(String(std::to_string(s.size()) + "_" + s.substr(s.size()/2, 16)));
+    };
+
+    std::string content(1024*512, '.');
+    uint32 state = 42;
+    for(char& c : content)
+    {
+        state = state * 1103515245 + 12345;
+        c = static_cast<char>('a' + (state >> 16) % 26);
+    }
+
+    auto expected = [&]
+    {
+        return std::to_string(content.size()) + "_" + content.substr(content.size()/2, 16);
+    };
+
+    //первая отправка - целиком
+    b._traffic2 = 0;
+    EXPECT_EQ(expected(), b._i2->out_m1(content, true).value());
+    uint64 first = b._traffic2;
+    EXPECT_GT(first, content.size());
+
+    //повтор - только ссылки
+    b._traffic2 = 0;
+    EXPECT_EQ(expected(), b._i2->out_m1(content, true).value());
+    uint64 second = b._traffic2;
+    EXPECT_LT(second*4, first);
+
+    //локальная правка - переотправляется только затронутый кусок
+    content[content.size()/2] = '!';
+    b._traffic2 = 0;
+    EXPECT_EQ(expected(), b._i2->out_m1(content, true).value());
+    uint64 third = b._traffic2;
+    EXPECT_LT(third*3, first);
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, deduplication_negotiated)
+{
+    auto run = [](uint32 cacheSize1)
+    {
+        Bundle b(protocol::Requirements::ciphering, cacheSize1);
+
+        b._i1->out_m1() += [](String s, bool)
+        {
+            return readyFuture(String(std::to_string(s.size())));
+        };
+
+        std::string content(1024*256, '.');
+        uint32 state = 42;
+        for(char& c : content)
+        {
+            state = state * 1103515245 + 12345;
+            c = static_cast<char>('a' + (state >> 16) % 26);
+        }
+
+        EXPECT_EQ(std::to_string(content.size()), b._i2->out_m1(content, true).value());
+
+        b._traffic2 = 0;
+        EXPECT_EQ(std::to_string(content.size()), b._i2->out_m1(content, true).value());
+        uint64 repeated = b._traffic2;
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        return repeated;
+    };
+
+    //получатель с кешем поменьше - отправитель кодирует в его объем
+    EXPECT_LT(run(1024*1024)*4, 1024*256u);
+
+    //получатель без дедупликации - сообщения уходят целиком, без отказа
+    EXPECT_GT(run(0), 1024*256u);
+}
@@ -0,0 +1,125 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/cipheringBundle.hpp"
+#include <dci/crypto.hpp>
+
+using Bundle = utils::CipheringBundle;
+using utils::resBuilder;
+
+namespace
+{
+    //внешний шифровальщик: кадры полезной нагрузки на выделенных номерах, пустое тело
+    void injectFrames(Bundle& b, const protocol::SessionKeys& keys)
+    {
+        for(uint32 i(0); i<keys.frames; ++i)
+        {
+            dci::crypto::ChaCha20Poly1305 aead;
+            aead.setKey(keys.key.data(), static_cast<uint32>(keys.key.size()));
+            aead.setAd(keys.ad.data(), static_cast<uint32>(keys.ad.size()));
+
+            uint8 nonce[8];
+            for(uint32 k(0); k<sizeof(nonce); ++k)
+            {
+                nonce[k] = static_cast<uint8>((keys.nonce + i) >> (8*k));
+            }
+            aead.start(nonce, sizeof(nonce));
+
+            uint8 frame[3 + 16] = {1, 0, 0};//payloadLastChunk, длина 0
+            aead.encipher(frame, frame, 3);
+            aead.encipherFinish(frame + 3);
+
+            Bytes data;
+            data.end().write(frame, sizeof(frame));
+            b._r1->input(std::move(data));
+        }
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, exportKeys)
+{
+    Bundle b;
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    std::string content = "content_"+std::string(50, '.');
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+
+    uint32 keyChanges = 0;
+    b._p2->outputKeyChanged() += [&]
+    {
+        keyChanges++;
+    };
+
+    protocol::SessionKeys keys = b._p2->exportOutputKeys(3).value();
+    EXPECT_EQ(protocol::Aead::chacha20poly1305, keys.aead);
+    EXPECT_EQ(3u, keys.frames);
+
+    injectFrames(b, keys);
+
+    EXPECT_FALSE(b._fail1);
+
+    //собственные кадры продолжаются после выделенных номеров
+    EXPECT_TRUE(resBuilder(content, false) == b._i2->out_m1(content, false).value());
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    //смена ключа по порогу уведомляется
+    b._p2->setRekeyPolicy(1, 0, 0);
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+    EXPECT_LT(0u, keyChanges);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, exportKeys_rekeyPolicy)
+{
+    Bundle b;
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    std::string content = "content_"+std::string(50, '.');
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+
+    uint32 keyChanges = 0;
+    b._p2->outputKeyChanged() += [&]
+    {
+        keyChanges++;
+    };
+
+    b._p2->setRekeyPolicy(4, 0, 0);
+
+    //выделяется не больше оставшегося до порога
+    protocol::SessionKeys keys = b._p2->exportOutputKeys(100).value();
+    EXPECT_LT(0u, keys.frames);
+    EXPECT_GE(4u, keys.frames);
+    injectFrames(b, keys);
+
+    //порог исчерпан выделенным - следующее выделение на новом ключе
+    for(int k(0); k<4 && !keyChanges; ++k)
+    {
+        keys = b._p2->exportOutputKeys(100).value();
+        EXPECT_LT(0u, keys.frames);
+        EXPECT_GE(4u, keys.frames);
+        injectFrames(b, keys);
+    }
+
+    EXPECT_LT(0u, keyChanges);
+    EXPECT_FALSE(b._fail1);
+    EXPECT_EQ(1u, b._p2->stats().value().rekeys);
+
+    //собственные кадры после выделенных, на новом ключе
+    EXPECT_TRUE(resBuilder(content, false) == b._i2->out_m1(content, false).value());
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+}
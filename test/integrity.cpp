@@ -7,6 +7,7 @@
 
 #include "utils/bundle.hpp"
 #include "test/victimInterface.hpp"
+#include <iostream>
 
 using namespace dci::idl::stiac::test;
 
@@ -20,6 +21,7 @@ namespace
 
         bool _forceCorrupt1 = false;
         bool _forceCorrupt2 = false;
+        bool _forceCorruptTail2 = false;
 
         bool _fail1 = false;
         bool _fail2 = false;
@@ -27,7 +29,7 @@ namespace
         bool _integrityViolationFail1 = false;
         bool _integrityViolationFail2 = false;
 
-        Bundle()
+        Bundle(protocol::Checksum checksum = protocol::Checksum::crc64, uint32 maxChunkSize = 0)
             : ::utils::Bundle(false, false)
         {
             _inputRequirements = protocol::Requirements::integrity;
@@ -35,6 +37,15 @@ namespace
 
             init();
 
+            _p1->setChecksum(checksum);
+            _p2->setChecksum(checksum);
+
+            if(maxChunkSize)
+            {
+                _p1->setMaxChunkSize(maxChunkSize);
+                _p2->setMaxChunkSize(maxChunkSize);
+            }
+
             _session.flush();
             _r1->output() += _session * [this](Bytes&& data)
             {
@@ -57,6 +68,15 @@ namespace
                     c ^= 1;
                     data.begin().write(&c, 1);
                 }
+                if(_forceCorruptTail2)
+                {
+                    //последний байт - контрольная сумма, заголовок и тело целы
+                    std::string raw(data.size(), '\0');
+                    data.begin().read(raw.data(), static_cast<uint32>(raw.size()));
+                    raw.back() ^= 1;
+                    data.clear();
+                    data.end().write(raw.data(), static_cast<uint32>(raw.size()));
+                }
                 _r1->input(std::move(data));
             };
 
@@ -139,3 +159,114 @@ TEST(module_stiac, integrity)
     b._i2->out_m1(content, true);
     EXPECT_TRUE(b._integrityViolationFail1);
 }
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, integrity_crc32c)
+{
+    Bundle b(protocol::Checksum::crc32c);
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    //мелкие и крупные, последние режутся на много кусков
+    for(std::size_t size : {std::size_t(50), std::size_t(1024*100)})
+    {
+        std::string content = "content_"+std::string(size, '.');
+        EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+    }
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    b._forceCorrupt2 = true;
+    std::string content = "content_"+std::string(50, '.');
+    b._i2->out_m1(content, true);
+    EXPECT_TRUE(b._integrityViolationFail1);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, integrity_longChunks)
+{
+    Bundle b(protocol::Checksum::crc64, 1024*1024);
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    //куски по мегабайту с varint заголовком
+    for(std::size_t size : {std::size_t(50), std::size_t(1024*1024*3)})
+    {
+        std::string content = "content_"+std::string(size, '.');
+        EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+    }
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    b._forceCorrupt2 = true;
+    std::string content = "content_"+std::string(50, '.');
+    b._i2->out_m1(content, true);
+    EXPECT_TRUE(b._integrityViolationFail1);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, integrity_chunkSizeThroughput)
+{
+    //сообщения по 8Мб: классические куски, наименьший varint предел и мегабайтные куски
+    for(uint32 maxChunkSize : {uint32(0), uint32(32768), uint32(1024*1024)})
+    {
+        Bundle b(protocol::Checksum::crc64, maxChunkSize);
+
+        b._i1->out_m1() += [](String s, bool b)
+        {
+            return readyFuture(resBuilder(s, b));
+        };
+
+        constexpr uint32 messages = 8;
+        std::string content(1024*1024*8, '.');
+
+        auto begin = std::chrono::steady_clock::now();
+
+        for(uint32 n(0); n<messages; ++n)
+        {
+            content[n] = 'x';
+            EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        //каждое сообщение проходит туда и обратно
+        std::cout<<"integrity, max chunk size "<<maxChunkSize<<": "
+                 <<static_cast<uint64>(2.0 * double(content.size()) * messages / seconds / 1024 / 1024)<<" MB/s"<<std::endl;
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, integrity_corruptNotDelivered)
+{
+    Bundle b;
+
+    uint32 calls = 0;
+    b._i1->out_m1() += [&](String s, bool b)
+    {
+        calls++;
+        return readyFuture(resBuilder(s, b));
+    };
+
+    std::string content = "content_"+std::string(50, '.');
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+    EXPECT_EQ(1u, calls);
+
+    //кусок с неверной суммой не доходит до получателя
+    b._forceCorruptTail2 = true;
+    b._i2->out_m1(content, true);
+
+    EXPECT_TRUE(b._integrityViolationFail1);
+    EXPECT_EQ(1u, calls);
+}
@@ -0,0 +1,78 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "utils/cipheringBundle.hpp"
+#include "crypto/keyPool.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace dci::module::stiac::crypto;
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, keyPool_fork)
+{
+    //дочерний процесс не должен получить ту же пару, что достанется родителю
+    KeyPool& pool = KeyPool::instance();
+
+    KeyPool::KeyPair kp;
+    for(uint32 i(0); i<100 && !pool.take(kp); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+
+    //дать запасу наполниться
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+
+    pid_t pid = ::fork();
+    ASSERT_LE(0, pid);
+
+    if(!pid)
+    {
+        KeyPool::KeyPair child;
+        if(!KeyPool::instance().take(child) && !KeyPool::generate(child))
+        {
+            ::_exit(1);
+        }
+
+        ::_exit(sizeof(child._public) == ::write(fds[1], child._public.data(), sizeof(child._public)) ? 0 : 1);
+    }
+
+    KeyPool::KeyPair parent;
+    EXPECT_TRUE(pool.take(parent) || KeyPool::generate(parent));
+
+    KeyPool::KeyPair child;
+    EXPECT_EQ(ssize_t(sizeof(child._public)), ::read(fds[0], child._public.data(), sizeof(child._public)));
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    EXPECT_NE(parent._public, child._public);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, keyPool_off)
+{
+    //без запаса ключи считаются на месте, соединение работает как обычно
+    utils::CipheringBundle b({}, false);
+
+    b._p1->setKeyPool(false);
+    b._p2->setKeyPool(false);
+    b._p1->setRekeyPolicy(4, 0, 0);
+    b._p2->setRekeyPolicy(4, 0, 0);
+
+    b.start();
+
+    utils::bulkExchange(b);
+}
@@ -0,0 +1,179 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/cipheringBundle.hpp"
+#include "utils/delay.hpp"
+#include <dci/crypto.hpp>
+#include <iostream>
+
+using utils::resBuilder;
+using utils::bulkExchange;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::CipheringBundle
+    {
+        Array<uint8, 32> _authPublic1 {};
+        Array<uint8, 32> _authPublic2 {};
+
+        Bundle(bool earlyPayload1 = false, bool earlyPayload2 = false, bool doStart = true)
+            : ::utils::CipheringBundle({}, false)
+        {
+            dci::crypto::curve25519::basepoint(_authLocal1.data(), _authPublic1.data());
+            dci::crypto::curve25519::basepoint(_authLocal2.data(), _authPublic2.data());
+
+            _p1->setAuthRemote(_authPublic2);
+            _p2->setAuthRemote(_authPublic1);
+
+            _p1->setEarlyPayload(earlyPayload1);
+            _p2->setEarlyPayload(earlyPayload2);
+
+            if(doStart)
+            {
+                start();
+            }
+        }
+    };
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, knownRemote)
+{
+    //ключи удаленных сторон известны заранее, полезная нагрузка идет первым пакетом
+    Bundle b(true, true);
+
+    b._p1->setRekeyPolicy(4, 0, 0);
+    b._p2->setRekeyPolicy(4, 0, 0);
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    std::string content = "content_"+std::string(50, '.');
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+
+    EXPECT_TRUE(b._authPublic2 == b._p1->remoteAuth().value());
+    EXPECT_TRUE(b._authPublic1 == b._p2->remoteAuth().value());
+
+    bulkExchange(b);
+
+    //первый эфемерный ключ рукопожатия сменой не считается
+    protocol::Stats s1 = b._p1->stats().value();
+    protocol::Stats s2 = b._p2->stats().value();
+    EXPECT_EQ(s1.remoteRekeys, s2.rekeys);
+    EXPECT_EQ(s2.remoteRekeys, s1.rekeys);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, knownRemote_noRekeys)
+{
+    //без политики смены ключей нет ни своих, ни чужих смен
+    Bundle b(true, true);
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    for(int k(0); k<8; ++k)
+    {
+        std::string content = "content_"+std::to_string(k);
+        EXPECT_TRUE(resBuilder(content, k%2) == b._i2->out_m1(content, k%2).value());
+    }
+
+    protocol::Stats s1 = b._p1->stats().value();
+    protocol::Stats s2 = b._p2->stats().value();
+    EXPECT_EQ(0u, s1.rekeys);
+    EXPECT_EQ(0u, s2.rekeys);
+    EXPECT_EQ(0u, s1.remoteRekeys);
+    EXPECT_EQ(0u, s2.remoteRekeys);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, knownRemote_noEarlyPayload)
+{
+    //по умолчанию первый пакет без нагрузки, вызов уходит после эфемерного ключа удаленной стороны
+    Bundle b;
+
+    b._i1->out_m1() += [](String s, bool b)
+    {
+        return readyFuture(resBuilder(s, b));
+    };
+
+    std::string content = "content_"+std::string(50, '.');
+    EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+
+    EXPECT_TRUE(b._authPublic2 == b._p1->remoteAuth().value());
+    EXPECT_TRUE(b._authPublic1 == b._p2->remoteAuth().value());
+
+    bulkExchange(b);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, knownRemote_earlyPayloadOneSided)
+{
+    //нагрузка поставлена до старта и уходит первым пакетом, вторая сторона такую придерживает
+    //до кадра первой на ключе со своим эфемерным: отказа нет, вызов проходит на круг позже
+    Bundle b(true, false, false);
+
+    b._l2->got() += [&](idl::Interface&& i)
+    {
+        b._i2 = i;
+        return readyFuture(None{});
+    };
+
+    auto put = b._l1->put(idl::Interface(b._i1.init2()));
+
+    b._p1->start();
+    b._p2->start();
+
+    put.value();
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+
+    bulkExchange(b);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, knownRemote_timeToFirstCall)
+{
+    //время до ответа на первый вызов при круге 50мс: с нагрузкой в первом пакете - один круг,
+    //без нее запрос ждет первого ключа удаленной стороны, еще полкруга
+    auto measure = [](bool earlyPayload)
+    {
+        Bundle b(earlyPayload, earlyPayload, false);
+
+        b._session.flush();
+
+        utils::Delay d12{std::chrono::milliseconds{25}, [&](Bytes&& data){b._r2->input(std::move(data));}};
+        utils::Delay d21{std::chrono::milliseconds{25}, [&](Bytes&& data){b._r1->input(std::move(data));}};
+
+        b._r1->output() += b._session * [&](Bytes&& data){d12.push(std::move(data));};
+        b._r2->output() += b._session * [&](Bytes&& data){d21.push(std::move(data));};
+
+        auto begin = std::chrono::steady_clock::now();
+        b.start();
+        auto time = std::chrono::steady_clock::now() - begin;
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        b._session.flush();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(time);
+    };
+
+    std::chrono::milliseconds early = measure(true);
+    std::chrono::milliseconds late = measure(false);
+
+    std::cout<<"time to first call, rtt 50ms: early payload "<<early.count()<<"ms, without "<<late.count()<<"ms"<<std::endl;
+
+    EXPECT_LT(early.count(), 75);
+    EXPECT_GE(late.count(), 75);
+}
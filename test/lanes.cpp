@@ -0,0 +1,156 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>                        _bulk1;
+        Victim<>                        _small1;
+        std::vector<Victim<>::Opposite> _got2;
+
+        std::vector<std::string> _order;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(bool lanes1, bool lanes2, protocol::Requirements requirements)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = requirements;
+            _outputRequirements = requirements;
+
+            init();
+
+            if(protocol::Requirements::ciphering == requirements)
+            {
+                _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+                _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            }
+
+            _p1->setPriorityLanes(lanes1);
+            _p2->setPriorityLanes(lanes2);
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _got2.emplace_back(i);
+                return readyFuture(None{});
+            };
+
+            _bulk1.init2();
+            _bulk1->out_m1() += [this](String s, bool)
+            {
+                _order.push_back("bulk");
+                return readyFuture(String(std::to_string(s.size())));
+            };
+
+            _small1.init2();
+            _small1->out_m1() += [this](String s, bool)
+            {
+                _order.push_back(s.size() < 1024*64 ? "small" : "bulk");
+                return readyFuture(String(std::to_string(s.size())));
+            };
+
+            _l1->put(idl::Interface(_bulk1.opposite())).value();
+            _l1->put(idl::Interface(_small1.opposite())).value();
+        }
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<std::string> order(bool lanes1, bool lanes2, protocol::Requirements requirements = protocol::Requirements::null)
+    {
+        Bundle b(lanes1, lanes2, requirements);
+        EXPECT_EQ(2u, b._got2.size());
+
+        std::string content(1024*1024*4, '.');
+
+        //крупный вызов уже выдается, мелкий по другому интерфейсу поставлен следом
+        auto bulk = b._got2[0]->out_m1(content, true);
+        auto small = b._got2[1]->out_m1(String("small"), true);
+
+        EXPECT_EQ(String("5"), small.value());
+        EXPECT_EQ(String(std::to_string(content.size())), bulk.value());
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        return b._order;
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, lanes_smallOvertakesBulk)
+{
+    EXPECT_EQ((std::vector<std::string>{"small", "bulk"}), order(true, true));
+    EXPECT_EQ((std::vector<std::string>{"small", "bulk"}), order(true, true, protocol::Requirements::ciphering));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, lanes_disabledKeepsOrder)
+{
+    EXPECT_EQ((std::vector<std::string>{"bulk", "small"}), order(false, false));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, lanes_requireBothSides)
+{
+    //записи полос объявила только одна сторона - поток без них, порядок прежний, без отказа
+    EXPECT_EQ((std::vector<std::string>{"bulk", "small"}), order(true, false, protocol::Requirements::ciphering));
+    EXPECT_EQ((std::vector<std::string>{"bulk", "small"}), order(false, true, protocol::Requirements::ciphering));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, lanes_linkOrderKept)
+{
+    Bundle b(true, true, protocol::Requirements::null);
+    EXPECT_EQ(2u, b._got2.size());
+
+    //мелкие вызовы одного звена на несколько проходов выдачи, следом крупный того же звена:
+    //его полоса получает порции каждый проход, но завершиться раньше мелких он не должен
+    b._p2->setAutoPumping(protocol::AutoPumping::none);
+
+    std::vector<Future<String>> calls;
+    for(int k(0); k<15; ++k)
+    {
+        calls.emplace_back(b._got2[1]->out_m1(String(1024*40, '.'), true));
+    }
+    calls.emplace_back(b._got2[1]->out_m1(String(1024*70, '.'), true));
+
+    b._p2->setAutoPumping(protocol::AutoPumping::instantly);
+    b._p2->pump();
+
+    for(Future<String>& call : calls)
+    {
+        call.value();
+    }
+
+    std::vector<std::string> expected(15, "small");
+    expected.push_back("bulk");
+    EXPECT_EQ(expected, b._order);
+
+    EXPECT_FALSE(b._fail1);
+    EXPECT_FALSE(b._fail2);
+}
@@ -0,0 +1,226 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "../utils/bundle.hpp"
+
+using namespace ::utils;
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, localEdge_stream)
+{
+    Bundle b;
+
+    //получатель на первой стороне
+    localEdge::Stream<> receiver;
+    localEdge::Stream<>::Opposite receiverOpposite = receiver.init2();
+
+    uint64 received = 0;
+    uint32 chunks = 0;
+    bool finished = false;
+
+    receiver->chunk() += [&](Bytes&& data)
+    {
+        EXPECT_FALSE(finished);
+        received += data.size();
+        chunks++;
+        return readyFuture(None{});
+    };
+
+    receiver->finish() += [&]()
+    {
+        finished = true;
+        return readyFuture(None{});
+    };
+
+    localEdge::Stream<>::Opposite remote;
+    b._l2->got() += [&](idl::Interface&& i)
+    {
+        remote = i;
+        return readyFuture(None{});
+    };
+
+    b._l1->put(idl::Interface(receiverOpposite)).value();
+    ASSERT_TRUE(!!remote);
+
+    //отправитель на второй стороне, через окно
+    localEdge::Stream<>::Opposite sender = b._l2->streamWindow(remote, 1024*1024).value();
+
+    std::string portion(1024*256, '.');
+    for(uint32 i(0); i<64; ++i)
+    {
+        Bytes data;
+        data.end().write(portion.data(), static_cast<uint32>(portion.size()));
+        sender->chunk(std::move(data)).value();
+    }
+
+    sender->finish().value();
+
+    EXPECT_EQ(64u, chunks);
+    EXPECT_EQ(uint64(64) * portion.size(), received);
+    EXPECT_TRUE(finished);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, localEdge_streamBackpressure)
+{
+    Bundle b;
+
+    //получатель подтверждает порции только по команде
+    localEdge::Stream<> receiver;
+    localEdge::Stream<>::Opposite receiverOpposite = receiver.init2();
+
+    std::deque<Promise<None>> acks;
+    bool finished = false;
+
+    receiver->chunk() += [&](Bytes&&)
+    {
+        acks.emplace_back();
+        return acks.back().future();
+    };
+
+    receiver->finish() += [&]()
+    {
+        finished = true;
+        return readyFuture(None{});
+    };
+
+    localEdge::Stream<>::Opposite remote;
+    b._l2->got() += [&](idl::Interface&& i)
+    {
+        remote = i;
+        return readyFuture(None{});
+    };
+
+    b._l1->put(idl::Interface(receiverOpposite)).value();
+    ASSERT_TRUE(!!remote);
+
+    localEdge::Stream<>::Opposite sender = b._l2->streamWindow(remote, 1024*4).value();
+
+    //отправитель не ждет подтверждений
+    std::string portion(1024, '.');
+    std::vector<Future<None>> sent;
+    for(uint32 i(0); i<16; ++i)
+    {
+        Bytes data;
+        data.end().write(portion.data(), static_cast<uint32>(portion.size()));
+        sent.push_back(sender->chunk(std::move(data)));
+    }
+
+    //в окно 4к уходят 4 порции, остальные ждут
+    EXPECT_EQ(4u, acks.size());
+    EXPECT_TRUE(sent[3].resolved());
+    EXPECT_FALSE(sent[4].resolved());
+
+    //каждое подтверждение пропускает ровно одну следующую порцию
+    for(uint32 i(0); i<16; ++i)
+    {
+        ASSERT_LT(i, acks.size());
+        acks[i].resolveValue(None{});
+
+        EXPECT_EQ(std::min(i+5, 16u), acks.size());
+        if(i+5 < 16)
+        {
+            EXPECT_TRUE(sent[i+4].resolved());
+            EXPECT_FALSE(sent[i+5].resolved());
+        }
+    }
+
+    for(Future<None>& f : sent)
+    {
+        EXPECT_TRUE(f.resolvedValue());
+    }
+
+    sender->finish().value();
+    EXPECT_TRUE(finished);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, localEdge_streamReceiverFail)
+{
+    Bundle b;
+
+    //получатель отказывает во второй порции
+    localEdge::Stream<> receiver;
+    localEdge::Stream<>::Opposite receiverOpposite = receiver.init2();
+
+    std::deque<Promise<None>> acks;
+    bool finished = false;
+
+    receiver->chunk() += [&](Bytes&&)
+    {
+        acks.emplace_back();
+        return acks.back().future();
+    };
+
+    receiver->finish() += [&]()
+    {
+        finished = true;
+        return readyFuture(None{});
+    };
+
+    localEdge::Stream<>::Opposite remote;
+    b._l2->got() += [&](idl::Interface&& i)
+    {
+        remote = i;
+        return readyFuture(None{});
+    };
+
+    b._l1->put(idl::Interface(receiverOpposite)).value();
+    ASSERT_TRUE(!!remote);
+
+    localEdge::Stream<>::Opposite sender = b._l2->streamWindow(remote, 1024*4).value();
+
+    std::string portion(1024, '.');
+    auto chunk = [&]
+    {
+        Bytes data;
+        data.end().write(portion.data(), static_cast<uint32>(portion.size()));
+        return sender->chunk(std::move(data));
+    };
+
+    std::vector<Future<None>> sent;
+    for(uint32 i(0); i<8; ++i)
+    {
+        sent.push_back(chunk());
+    }
+
+    ASSERT_EQ(4u, acks.size());
+    acks[0].resolveValue(None{});
+    EXPECT_TRUE(sent[4].resolvedValue());
+
+    //отказ валит все ожидающие порции тем же исключением
+    acks[1].resolveException(std::make_exception_ptr(std::runtime_error("rejected")));
+
+    auto expectRejected = [](Future<None>& f)
+    {
+        EXPECT_TRUE(f.resolvedException());
+        try
+        {
+            f.value();
+        }
+        catch(std::runtime_error& e)
+        {
+            EXPECT_EQ(std::string("rejected"), e.what());
+        }
+    };
+
+    for(uint32 i(5); i<8; ++i)
+    {
+        expectRejected(sent[i]);
+    }
+
+    //новые порции не принимаются
+    Future<None> late = chunk();
+    expectRejected(late);
+    EXPECT_EQ(5u, acks.size());
+
+    //finish не доходит до получателя и завершается отказом
+    Future<None> fin = sender->finish();
+    expectRejected(fin);
+    EXPECT_FALSE(finished);
+}
@@ -0,0 +1,105 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/cipheringBundle.hpp"
+#include <optional>
+
+using utils::resBuilder;
+using utils::bulkExchange;
+
+namespace
+{
+    struct Bundle
+        : public ::utils::CipheringBundle
+    {
+        std::optional<protocol::ResumptionTicket> _ticket1;
+        std::optional<protocol::ResumptionTicket> _ticket2;
+
+        Bundle(uint32 resumption, const protocol::ResumptionTicket* ticket = nullptr)
+            : ::utils::CipheringBundle({}, false)
+        {
+            _p1->setResumption(resumption);
+            _p2->setResumption(resumption);
+
+            _p1->resumptionTicket() += [this](protocol::ResumptionTicket t)
+            {
+                _ticket1 = t;
+            };
+
+            _p2->resumptionTicket() += [this](protocol::ResumptionTicket t)
+            {
+                _ticket2 = t;
+            };
+
+            if(ticket)
+            {
+                _p2->setResumptionTicket(*ticket);
+            }
+
+            start();
+        }
+    };
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, resumption)
+{
+    auto call = [](Bundle& b)
+    {
+        b._i1->out_m1() += [](String s, bool b)
+        {
+            return readyFuture(resBuilder(s, b));
+        };
+
+        std::string content = "content_"+std::string(50, '.');
+        EXPECT_TRUE(resBuilder(content, true) == b._i2->out_m1(content, true).value());
+    };
+
+    protocol::ResumptionTicket ticket {};
+
+    //полное рукопожатие, стороны выдают друг другу билеты
+    {
+        Bundle b(3600);
+        call(b);
+
+        EXPECT_FALSE(b._p1->stats().value().resumed);
+        ASSERT_TRUE(b._ticket2.has_value());
+        EXPECT_EQ(3600u, b._ticket2->lifetime);
+        EXPECT_TRUE(b._p2->remoteAuth().value() == b._ticket2->remote);
+
+        ticket = *b._ticket2;
+    }
+
+    //по билету, статические ключи не пересылаются, аутентификация та же
+    {
+        Bundle b(3600, &ticket);
+        call(b);
+
+        EXPECT_TRUE(b._p1->stats().value().resumed);
+        EXPECT_TRUE(b._p2->stats().value().resumed);
+        EXPECT_TRUE(ticket.remote == b._p2->remoteAuth().value());
+        EXPECT_FALSE(b._p1->remoteAuth().value() == protocol::PublicKey{});
+
+        //взамен использованного - новый
+        EXPECT_TRUE(b._ticket2.has_value());
+
+        bulkExchange(b);
+    }
+
+    //билет одноразовый, повтор - обычное рукопожатие
+    {
+        Bundle b(3600, &ticket);
+        call(b);
+
+        EXPECT_FALSE(b._p1->stats().value().resumed);
+        EXPECT_FALSE(b._p2->stats().value().resumed);
+        EXPECT_TRUE(ticket.remote == b._p2->remoteAuth().value());
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+    }
+}
@@ -0,0 +1,168 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+#include <cstring>
+
+using namespace dci::idl::stiac::test;
+
+namespace
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::array<uint8, 16> tuidOf(idl::Interface i)
+    {
+        idl::ILid lid = i.mdLid();
+
+        static_assert(sizeof(lid) == sizeof(std::array<uint8, 16>));
+        std::array<uint8, 16> res;
+        std::memcpy(res.data(), &lid, res.size());
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //настоящие tuid интерфейсов, которые ходят между сторонами в тесте
+    protocol::TuidTable table()
+    {
+        protocol::TuidTable res;
+
+        Victim<>::Opposite victim;
+        Victim<> victimOpposite = victim.init2();
+        res.push_back(tuidOf(idl::Interface(victim)));
+        res.push_back(tuidOf(idl::Interface(victimOpposite)));
+
+        AsArgument<>::Opposite asArg;
+        AsArgument<> asArgOpposite = asArg.init2();
+        res.push_back(tuidOf(idl::Interface(asArg)));
+        res.push_back(tuidOf(idl::Interface(asArgOpposite)));
+
+        return res;
+    }
+
+    struct Bundle
+        : public ::utils::Bundle
+    {
+        Victim<>            _i1;
+        Victim<>::Opposite  _i2;
+
+        uint64 _traffic1 = 0;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        Bundle(protocol::Requirements requirements, uint32 version1, uint32 version2)
+            : ::utils::Bundle(false, false)
+        {
+            _inputRequirements = requirements;
+            _outputRequirements = requirements;
+
+            init();
+
+            if(protocol::Requirements::ciphering == requirements)
+            {
+                _p1->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_1"});
+                _p2->setAuthLocal(Array<uint8, 32>{"01234567890123456789012345678_2"});
+            }
+
+            _p1->setTuidTable(version1, table());
+            _p2->setTuidTable(version2, table());
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                _traffic1 += data.size();
+                _r2->input(std::move(data));
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                _r1->input(std::move(data));
+            };
+
+            _p1->failed() += [&](ExceptionPtr)
+            {
+                _fail1 = true;
+            };
+
+            _p2->failed() += [&](ExceptionPtr)
+            {
+                _fail2 = true;
+            };
+
+            start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _l1->put(idl::Interface(_i1.init2())).value();
+        }
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //объем первой передачи интерфейса
+    uint64 passInterfaces(protocol::Requirements requirements, uint32 version1, uint32 version2)
+    {
+        Bundle b(requirements, version1, version2);
+
+        AsArgument<> asArgFwd;
+        b._i2->in_m2() += [&](AsArgument<> arg)
+        {
+            EXPECT_TRUE(arg);
+            asArgFwd = arg;
+        };
+
+        uint64 firstTraffic = 0;
+
+        //каждый раз новый экземпляр, тип тот же
+        for(int i(0); i<3; ++i)
+        {
+            AsArgument<>::Opposite asArgBwd;
+
+            uint64 traffic = b._traffic1;
+            b._i1->in_m2(asArgBwd.init2());
+            if(!i)
+            {
+                firstTraffic = b._traffic1 - traffic;
+            }
+
+            int cnt = 0;
+            asArgBwd->in_m() += [&]
+            {
+                cnt++;
+            };
+
+            asArgFwd->in_m();
+            EXPECT_EQ(1, cnt);
+        }
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        return firstTraffic;
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, tuidTable)
+{
+    passInterfaces(protocol::Requirements::null, 1, 1);
+    passInterfaces(protocol::Requirements::ciphering, 1, 1);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(module_stiac, tuidTable_versionMismatch)
+{
+    //версии не совпали - таблица не применяется, номера назначаются по ходу
+    uint64 mismatched = passInterfaces(protocol::Requirements::ciphering, 1, 2);
+
+    //при совпавших tuid не передается даже в первый раз
+    uint64 matched = passInterfaces(protocol::Requirements::ciphering, 1, 1);
+    EXPECT_LT(matched, mismatched);
+}
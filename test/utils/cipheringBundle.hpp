@@ -0,0 +1,208 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "utils/bundle.hpp"
+#include "test/victimInterface.hpp"
+
+namespace utils
+{
+    //параметры задаются до старта, у обеих сторон одинаковые
+    struct CipheringSettings
+    {
+        protocol::Aead          aeads           = protocol::Aead::chacha20poly1305;
+        bool                    batching        = false;
+        uint32                  maxFrameSize    = 0;
+        protocol::Requirements  requirements    = protocol::Requirements::ciphering;
+        uint32                  ratchet         = 0;
+        bool                    offload         = false;
+        uint32                  rekeyMessages   = 0;
+    };
+
+    struct CipheringBundle
+        : public Bundle
+    {
+        using Settings = CipheringSettings;
+
+        idl::stiac::test::Victim<>            _i1;
+        idl::stiac::test::Victim<>::Opposite  _i2;
+
+        bool _forceCorrupt1 = false;
+        bool _forceCorrupt2 = false;
+
+        bool _fail1 = false;
+        bool _fail2 = false;
+
+        bool _integrityViolationFail1 = false;
+        bool _integrityViolationFail2 = false;
+
+        Array<uint8, 32> _authLocal1 {"01234567890123456789012345678_1"};
+        Array<uint8, 32> _authLocal2 {"01234567890123456789012345678_2"};
+
+        CipheringBundle(const Settings& settings = {}, bool doStart = true)
+            : Bundle(false, false)
+        {
+            _inputRequirements = settings.requirements;
+            _outputRequirements = settings.requirements;
+
+            init();
+
+            _p1->setAuthLocal(_authLocal1);
+            _p2->setAuthLocal(_authLocal2);
+
+            _p1->setAeads(settings.aeads);
+            _p2->setAeads(settings.aeads);
+
+            _p1->setBatchCiphering(settings.batching);
+            _p2->setBatchCiphering(settings.batching);
+
+            _p1->setRatchet(settings.ratchet);
+            _p2->setRatchet(settings.ratchet);
+
+            _p1->setHandshakeOffload(settings.offload);
+            _p2->setHandshakeOffload(settings.offload);
+
+            if(settings.maxFrameSize)
+            {
+                _p1->setMaxFrameSize(settings.maxFrameSize);
+                _p2->setMaxFrameSize(settings.maxFrameSize);
+            }
+
+            if(settings.rekeyMessages)
+            {
+                _p1->setRekeyPolicy(settings.rekeyMessages, 0, 0);
+                _p2->setRekeyPolicy(settings.rekeyMessages, 0, 0);
+            }
+
+            _session.flush();
+            _r1->output() += _session * [this](Bytes&& data)
+            {
+                if(_forceCorrupt1)
+                {
+                    char c;
+                    data.begin().read(&c, 1);
+                    c ^= 1;
+                    data.begin().write(&c, 1);
+                }
+
+                while(!data.empty())
+                {
+                    Bytes granula;
+                    data.begin().removeTo(granula, 1);
+                    _r2->input(std::move(granula));
+                }
+            };
+
+            _r2->output() += _session * [this](Bytes&& data)
+            {
+                if(_forceCorrupt2)
+                {
+                    char c;
+                    data.begin().read(&c, 1);
+                    c ^= 1;
+                    data.begin().write(&c, 1);
+                }
+
+                //лить данные мелкой гранулой, чтобы проверить как их гранулирует кифер
+                while(!data.empty())
+                {
+                    Bytes granula;
+                    data.begin().removeTo(granula, 1);
+                    _r1->input(std::move(granula));
+                }
+            };
+
+            _p2->failed() += [&](ExceptionPtr e)
+            {
+                _fail2 = true;
+
+                try
+                {
+                    std::rethrow_exception(e);
+                }
+                catch(const protocol::IntegrityViolation&)
+                {
+                    _integrityViolationFail2 = true;
+                }
+                catch(const protocol::DecipheringFail&)
+                {
+                    _integrityViolationFail2 = true;
+                }
+            };
+
+            _p1->failed() += [&](ExceptionPtr e)
+            {
+                _fail1 = true;
+
+                try
+                {
+                    std::rethrow_exception(e);
+                }
+                catch(const protocol::IntegrityViolation&)
+                {
+                    _integrityViolationFail1 = true;
+                }
+                catch(const protocol::DecipheringFail&)
+                {
+                    _integrityViolationFail1 = true;
+                }
+            };
+
+            if(doStart)
+            {
+                start();
+            }
+        }
+
+        //параметры, не вошедшие в Settings, выставляются между конструктором с doStart=false и start
+        void start()
+        {
+            Bundle::start();
+
+            _l2->got() += [&](idl::Interface&& i)
+            {
+                _i2 = i;
+                return readyFuture(None{});
+            };
+
+            _l1->put(idl::Interface(_i1.init2())).value();
+        }
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    inline String resBuilder(String s, bool b)
+    {
+        return "pre_" + s + "_mid_" + (b ? "true" : "false") + "_post";
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    inline void bulkExchange(CipheringBundle& b)
+    {
+        b._i1->out_m1() += [](String s, bool b)
+        {
+            return readyFuture(resBuilder(s, b));
+        };
+
+        for(int k(0); k<3; ++k)
+        {
+            for(int k2(0); k2<6; ++k2)
+            {
+                std::string content = "content_"+std::to_string(k2)+"_"+std::string(static_cast<std::size_t>(20000*k2 + k), '.');
+                EXPECT_TRUE(resBuilder(content, k2%2) == b._i2->out_m1(content, k2%2).value());
+            }
+        }
+
+        EXPECT_FALSE(b._fail1);
+        EXPECT_FALSE(b._fail2);
+
+        b._forceCorrupt2 = true;
+        std::string content = "content_"+std::string(50, '.');
+        b._i2->out_m1(content, true);
+        EXPECT_TRUE(b._integrityViolationFail1);
+    }
+}
@@ -0,0 +1,57 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/poll/timer.hpp>
+#include <deque>
+#include <functional>
+#include <chrono>
+
+namespace utils
+{
+    //задержка данных в одну сторону, для замеров с заданным временем круга; точность - тик в 1мс
+    class Delay
+    {
+    public:
+        Delay(std::chrono::milliseconds delay, std::function<void(dci::Bytes&&)> deliver)
+            : _delay{delay}
+            , _deliver{std::move(deliver)}
+        {
+        }
+
+        void push(dci::Bytes&& data)
+        {
+            _flights.emplace_back(std::chrono::steady_clock::now() + _delay, std::move(data));
+            _ticker.start();
+        }
+
+    private:
+        void tick()
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            while(!_flights.empty() && _flights.front().first <= now)
+            {
+                dci::Bytes data = std::move(_flights.front().second);
+                _flights.pop_front();
+                _deliver(std::move(data));
+            }
+
+            if(_flights.empty())
+            {
+                _ticker.stop();
+            }
+        }
+
+    private:
+        std::chrono::milliseconds _delay;
+        std::function<void(dci::Bytes&&)> _deliver;
+        std::deque<std::pair<std::chrono::steady_clock::time_point, dci::Bytes>> _flights;
+        dci::poll::Timer _ticker{std::chrono::milliseconds{1}, true, [this]{tick();}};
+    };
+}